@@ -30,9 +30,9 @@ import functools
 from ._pygit2 import *
 
 # High level API
-from .blame import Blame, BlameHunk
+from .blame import Blame, BlameCache, BlameHunk
 from .callbacks import git_clone_options, git_fetch_options, get_credentials
-from .callbacks import Payload, RemoteCallbacks
+from .callbacks import Payload, RemoteCallbacks, CheckoutCallbacks
 from .config import Config
 from .credentials import *
 from .errors import check_error, Passthrough
@@ -58,7 +58,9 @@ h_files = [
     'oid.h',
     'blame.h',
     'buffer.h',
+    'blob.h',
     'strarray.h',
+    'pathspec.h',
     'diff.h',
     'checkout.h',
     'pack.h',
@@ -75,6 +77,7 @@ h_files = [
     'index.h',
     'merge.h',
     'net.h',
+    'object.h',
     'refspec.h',
     'repository.h',
     'revert.h',
@@ -23,10 +23,16 @@
 # the Free Software Foundation, 51 Franklin Street, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 
+# Import from the Standard Library
+from array import array
+from bisect import bisect_right
+from collections import namedtuple, OrderedDict
+
 # Import from pygit2
+from .errors import check_error
 from .ffi import ffi, C
-from .utils import GenericIterator
-from ._pygit2 import Signature, Oid
+from .utils import GenericIterator, to_bytes
+from ._pygit2 import Signature, Oid, Commit, Patch, blame_hunks_table
 
 
 def wrap_signature(csig):
@@ -98,19 +104,46 @@ class BlameHunk:
 class Blame:
 
     @classmethod
-    def _from_c(cls, repo, ptr):
+    def _from_c(cls, repo, ptr, path=None, newest_commit=None, options=None):
         blame = cls.__new__(cls)
         blame._repo = repo
         blame._blame = ptr
+        blame._hunks = None
+        blame._path = path
+        blame._newest_commit = newest_commit
+        blame._options = options or {}
+        # The contents blamed, when they are not those of newest_commit
+        blame._contents = None
+        return blame
+
+    @classmethod
+    def _from_hunks(cls, repo, hunks, path, newest_commit, options, contents):
+        # Built from the hunks of other blames, which they keep alive
+        blame = cls._from_c(repo, None, path, newest_commit, options)
+        blame._hunks = hunks
+        blame._contents = contents
         return blame
 
     def __del__(self):
-        C.git_blame_free(self._blame)
+        if self._blame is not None:
+            C.git_blame_free(self._blame)
+
+    @property
+    def _pointer(self):
+        return bytes(ffi.buffer(ffi.new('git_blame **', self._blame))[:])
 
     def __len__(self):
+        if self._hunks is not None:
+            return len(self._hunks)
+
         return C.git_blame_get_hunk_count(self._blame)
 
     def __getitem__(self, index):
+        if self._hunks is not None:
+            if index < 0:
+                raise IndexError
+            return self._hunks[index]
+
         chunk = C.git_blame_get_hunk_byindex(self._blame, index)
         if not chunk:
             raise IndexError
@@ -130,6 +163,16 @@ class Blame:
         if line_no < 0:
             raise IndexError
 
+        if self._hunks is not None:
+            starts = [hunk.final_start_line_number for hunk in self._hunks]
+            i = bisect_right(starts, line_no) - 1
+            if i < 0:
+                raise IndexError
+            hunk = self._hunks[i]
+            if line_no >= hunk.final_start_line_number + hunk.lines_in_hunk:
+                raise IndexError
+            return hunk
+
         chunk = C.git_blame_get_hunk_byline(self._blame, line_no)
         if not chunk:
             raise IndexError
@@ -138,3 +181,218 @@ class Blame:
 
     def __iter__(self):
         return GenericIterator(self)
+
+    def hunks_table(self):
+        """Return all the hunks of the Blame at once, as columns:
+
+        - lines: array('Q'), the number of lines of each hunk
+        - starts: array('Q'), the final start line numbers
+        - ids: bytes, the 20 bytes raw final commit ids one after the other
+        - orig_starts: array('Q'), the original start line numbers
+        - orig_ids: bytes, the raw original commit ids
+        - boundaries: array('B'), 1 if tracked to a boundary commit
+        - orig_paths: list of str
+
+        This reads the Blame in a single native pass, without creating a
+        BlameHunk, Oid and Signature objects per hunk as iterating does.
+        """
+        if self._hunks is not None:
+            hunks = self._hunks
+            return HunksTable(
+                array('Q', [hunk.lines_in_hunk for hunk in hunks]),
+                array('Q', [hunk.final_start_line_number for hunk in hunks]),
+                b''.join(hunk.final_commit_id.raw for hunk in hunks),
+                array('Q', [hunk.orig_start_line_number for hunk in hunks]),
+                b''.join(hunk.orig_commit_id.raw for hunk in hunks),
+                array('B', [hunk.boundary for hunk in hunks]),
+                [hunk.orig_path for hunk in hunks])
+
+        lines, starts, ids, orig_starts, orig_ids, boundaries, orig_paths = \
+            blame_hunks_table(self._pointer)
+        return HunksTable(_array('Q', lines), _array('Q', starts), ids,
+                          _array('Q', orig_starts), orig_ids,
+                          _array('B', boundaries), orig_paths)
+
+    def for_buffer(self, contents):
+        """
+        Return a new Blame for the given contents of the file, for instance
+        while it is being edited, reusing this one: the unchanged lines keep
+        their hunks, the changed lines get a hunk with a zero commit id.
+
+        Parameters:
+
+        contents
+            The new contents, bytes or str (encoded to UTF-8).
+        """
+        contents = to_bytes(contents)
+        if self._blame is None or self._contents is not None:
+            # libgit2 only knows the contents of the blames it read from a
+            # commit, not those of the blames made here or by a buffer
+            hunks = self._splice(self._data(), contents, _zero_hunks)
+            return Blame._from_hunks(self._repo, hunks, self._path, None,
+                                     self._options, contents)
+
+        cblame = ffi.new('git_blame **')
+        err = C.git_blame_buffer(cblame, self._blame, contents, len(contents))
+        check_error(err)
+
+        blame = Blame._from_c(self._repo, cblame[0], self._path, None,
+                              self._options)
+        blame._contents = contents
+        return blame
+
+    def update(self, new_commit):
+        """
+        Return the Blame of the same file at a newer commit, reusing this
+        one: only the lines changed between the two versions are blamed
+        again, and only through the commits in between.
+
+        If new_commit does not descend from the newest commit of this Blame,
+        the file is blamed from scratch.
+        """
+        repo = self._repo
+        commit = repo[new_commit].peel(Commit)
+        old = self._newest_commit
+        if commit.id == old:
+            return self
+
+        if old is None or not repo.descendant_of(commit.id, old):
+            return repo.blame(self._path, newest_commit=commit.id,
+                              **self._options)
+
+        def blame_range(start, lines):
+            return list(repo.blame(self._path, newest_commit=commit.id,
+                                   oldest_commit=old, min_line=start,
+                                   max_line=start + lines - 1,
+                                   **self._options))
+
+        new_data = repo[commit.tree[self._path].id].data
+        hunks = self._splice(self._data(), new_data, blame_range)
+        return Blame._from_hunks(repo, hunks, self._path, commit.id,
+                                 self._options, new_data)
+
+    def _data(self):
+        # The contents this blame describes
+        if self._contents is not None:
+            return self._contents
+
+        commit = self._repo[self._newest_commit]
+        return self._repo[commit.tree[self._path].id].data
+
+    def _splice(self, old_data, new_data, fill):
+        """
+        Return the hunks for new_data: those of this blame, moved, for the
+        lines unchanged since old_data, and fill(start, lines) for each
+        range of changed lines.
+        """
+        old_hunks = list(self)
+        hunks = []
+
+        def copy(new_start, old_start, length):
+            # The parts of the old hunks in old_start..old_start+length
+            end = old_start + length
+            for hunk in old_hunks:
+                h_start = hunk.final_start_line_number
+                h_end = h_start + hunk.lines_in_hunk
+                start, stop = max(h_start, old_start), min(h_end, end)
+                if start < stop:
+                    hunks.append(_moved_hunk(hunk, new_start + start - old_start,
+                                             stop - start, start - h_start))
+
+        old_total = old_data.count(b'\n')
+        if old_data and not old_data.endswith(b'\n'):
+            old_total += 1
+
+        o = n = 1
+        patch = Patch.create_from(old_data, new_data, context_lines=0)
+        for diff_hunk in patch.hunks:
+            old_lines, new_lines = diff_hunk.old_lines, diff_hunk.new_lines
+            # With no old lines, old_start is the line before the insertion
+            same = diff_hunk.old_start - o + (1 if old_lines == 0 else 0)
+            copy(n, o, same)
+            o += same + old_lines
+            n += same
+            if new_lines:
+                hunks.extend(fill(n, new_lines))
+                n += new_lines
+        copy(n, o, old_total - o + 1)
+
+        return hunks
+
+
+def _moved_hunk(hunk, start, lines, skip):
+    # A copy of the hunk, cut and moved; it keeps the blame owning the
+    # signatures and path alive
+    chunk = ffi.new('git_blame_hunk *')
+    ffi.memmove(chunk, hunk._hunk, ffi.sizeof('git_blame_hunk'))
+    chunk.final_start_line_number = start
+    chunk.lines_in_hunk = lines
+    chunk.orig_start_line_number += skip
+    return BlameHunk._from_c(hunk._blame, chunk)
+
+
+def _zero_hunks(start, lines):
+    # Like the hunks git_blame_buffer makes for changed lines
+    chunk = ffi.new('git_blame_hunk *')
+    chunk.final_start_line_number = start
+    chunk.orig_start_line_number = start
+    chunk.lines_in_hunk = lines
+    return [BlameHunk._from_c(None, chunk)]
+
+
+class BlameCache:
+    """
+    Keep the blames computed by (path, commit), and derive the blame of a
+    path at a new commit from the closest cached ancestor with
+    Blame.update(), so views following the history of a file only blame
+    the regions that changed.
+    """
+
+    def __init__(self, repo, size=64, **options):
+        """
+        Parameters:
+
+        size
+            The maximum number of blames kept.
+
+        options
+            Passed to Repository.blame(), except newest_commit.
+        """
+        self._repo = repo
+        self._size = size
+        self._options = options
+        self._blames = OrderedDict()
+
+    def blame(self, path, commit):
+        """Return the Blame of path at the given commit."""
+        repo = self._repo
+        commit = repo[commit].peel(Commit).id
+        key = (path, commit)
+        blame = self._blames.get(key)
+        if blame is not None:
+            self._blames.move_to_end(key)
+            return blame
+
+        # Most recently used first
+        for (other_path, other), base in reversed(self._blames.items()):
+            if other_path == path and repo.descendant_of(commit, other):
+                blame = base.update(commit)
+                break
+        else:
+            blame = repo.blame(path, newest_commit=commit, **self._options)
+
+        self._blames[key] = blame
+        if len(self._blames) > self._size:
+            self._blames.popitem(last=False)
+        return blame
+
+
+HunksTable = namedtuple('HunksTable',
+                        'lines starts ids orig_starts orig_ids boundaries '
+                        'orig_paths')
+
+
+def _array(typecode, data):
+    a = array(typecode)
+    a.frombytes(data)
+    return a
@@ -210,6 +210,55 @@ class RemoteCallbacks(Payload):
         """
 
 
+class CheckoutCallbacks(Payload):
+    """Base class for pygit2 checkout callbacks.
+
+    Inherit from this class and override the callbacks which you want to use
+    in your class, which you can then pass to the checkout operations, e.g.
+    repo.checkout_head(callbacks=MyCheckoutCallbacks()).
+
+    libgit2 ignores the return value of these callbacks, so an exception
+    raised by them does not stop the checkout, it is re-raised once the
+    checkout returns.
+    """
+
+    def checkout_progress(self, path, completed_steps, total_steps):
+        """
+        Progress callback, called once before any file is written and then
+        after each one. Override with your own function to report checkout
+        progress.
+
+        Parameters:
+
+        path : str or None
+            The path just written, None for the first call.
+
+        completed_steps : int
+            The number of files checked out so far.
+
+        total_steps : int
+            The number of files to check out.
+        """
+
+    def checkout_perfdata(self, mkdir_calls, stat_calls, chmod_calls):
+        """
+        Performance data callback, called once at the end of the checkout.
+        Override with your own function to record how much file system work
+        the checkout did.
+
+        Parameters:
+
+        mkdir_calls : int
+            The number of directories created.
+
+        stat_calls : int
+            The number of files stat'ed.
+
+        chmod_calls : int
+            The number of files whose mode was changed.
+        """
+
+
 #
 # The context managers below wrap the calls to libgit2 functions, which them in
 # turn call to callbacks defined later in this module. These context managers
@@ -309,6 +358,27 @@ def git_remote_callbacks(payload):
     yield payload
 
 
+def git_checkout_callbacks(payload, copts):
+    """Plug the callbacks overriden by the payload into the checkout
+    options. Return the handle, which must be kept alive until the checkout
+    is done.
+    """
+    handle = ffi.new_handle(payload)
+    payload._stored_exception = None
+
+    # Calling back into Python for every file has a cost, only do it when
+    # the callback was overriden
+    cls = type(payload)
+    if cls.checkout_progress is not CheckoutCallbacks.checkout_progress:
+        copts.progress_cb = C._checkout_progress_cb
+        copts.progress_payload = handle
+    if cls.checkout_perfdata is not CheckoutCallbacks.checkout_perfdata:
+        copts.perfdata_cb = C._checkout_perfdata_cb
+        copts.perfdata_payload = handle
+
+    return handle
+
+
 #
 # C callbacks
 #
@@ -343,6 +413,24 @@ def libgit2_callback(f):
     return ffi.def_extern()(wrapper)
 
 
+def libgit2_void_callback(f):
+    """Like libgit2_callback, for the callbacks whose return value libgit2
+    ignores. The first exception is kept, to be re-raised by the pygit2 API
+    once libgit2 returns.
+    """
+    @wraps(f)
+    def wrapper(*args):
+        data = ffi.from_handle(args[-1])
+        args = args[:-1] + (data,)
+        try:
+            f(*args)
+        except Exception as e:
+            if data._stored_exception is None:
+                data._stored_exception = e
+
+    return ffi.def_extern()(wrapper)
+
+
 @libgit2_callback
 def _certificate_cb(cert_i, valid, host, data):
     # We want to simulate what should happen if libgit2 supported pass-through
@@ -367,6 +455,17 @@ def _certificate_cb(cert_i, valid, host, data):
     return 0
 
 
+@libgit2_void_callback
+def _checkout_perfdata_cb(perfdata, data):
+    data.checkout_perfdata(perfdata.mkdir_calls, perfdata.stat_calls,
+                           perfdata.chmod_calls)
+
+
+@libgit2_void_callback
+def _checkout_progress_cb(path, completed_steps, total_steps, data):
+    data.checkout_progress(maybe_string(path), completed_steps, total_steps)
+
+
 @libgit2_callback
 def _credentials_cb(cred_out, url, username, allowed, data):
     credentials = getattr(data, 'credentials', None)
@@ -18,3 +18,11 @@ int git_attr_get(
 	const char *name);
 
 git_attr_value_t git_attr_value(const char *attr);
+
+int git_attr_get_many(
+	const char **values_out,
+	git_repository *repo,
+	uint32_t flags,
+	const char *path,
+	size_t num_attr,
+	const char **names);
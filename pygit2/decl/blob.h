@@ -0,0 +1,13 @@
+int git_blob_lookup(git_blob **blob, git_repository *repo, const git_oid *id);
+void git_blob_free(git_blob *blob);
+const void * git_blob_rawcontent(const git_blob *blob);
+git_off_t git_blob_rawsize(const git_blob *blob);
+int git_blob_filtered_content(
+	git_buf *out,
+	git_blob *blob,
+	const char *as_path,
+	int check_for_binary_data);
+int git_blob_create_from_workdir(
+	git_oid *id,
+	git_repository *repo,
+	const char *relative_path);
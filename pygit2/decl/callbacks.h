@@ -4,6 +4,16 @@ extern "Python" int _certificate_cb(
     const char *host,
     void *payload);
 
+extern "Python" void _checkout_perfdata_cb(
+	const git_checkout_perfdata *perfdata,
+	void *payload);
+
+extern "Python" void _checkout_progress_cb(
+	const char *path,
+	size_t completed_steps,
+	size_t total_steps,
+	void *payload);
+
 extern "Python" int _credentials_cb(
     git_credential **out,
     const char *url,
@@ -3,6 +3,9 @@ typedef struct {
 	uint32_t nanoseconds;
 } git_index_time;
 
+#define GIT_INDEX_ENTRY_STAGEMASK ...
+#define GIT_INDEX_ENTRY_STAGESHIFT ...
+
 typedef struct git_index_entry {
 	git_index_time ctime;
 	git_index_time mtime;
@@ -22,19 +25,32 @@ typedef struct git_index_entry {
 	const char *path;
 } git_index_entry;
 
+typedef enum {
+	GIT_INDEX_CAPABILITY_IGNORE_CASE = 1,
+	GIT_INDEX_CAPABILITY_NO_FILEMODE = 2,
+	GIT_INDEX_CAPABILITY_NO_SYMLINKS = 4,
+	GIT_INDEX_CAPABILITY_FROM_OWNER  = -1,
+} git_index_capability_t;
+
 typedef int (*git_index_matched_path_cb)(
 	const char *path, const char *matched_pathspec, void *payload);
 
 void git_index_free(git_index *index);
 int git_index_open(git_index **out, const char *index_path);
 int git_index_read(git_index *index, int force);
+int git_index_caps(const git_index *index);
+int git_index_set_caps(git_index *index, int caps);
 int git_index_write(git_index *index);
+unsigned int git_index_version(git_index *index);
+int git_index_set_version(git_index *index, unsigned int version);
+const char * git_index_path(const git_index *index);
 size_t git_index_entrycount(const git_index *index);
 int git_index_find(size_t *at_pos, git_index *index, const char *path);
 int git_index_add_bypath(git_index *index, const char *path);
 int git_index_add(git_index *index, const git_index_entry *source_entry);
 int git_index_remove(git_index *index, const char *path, int stage);
 int git_index_read_tree(git_index *index, const git_tree *tree);
+int git_index_read_index(git_index *index, const git_index *new_index);
 int git_index_clear(git_index *index);
 int git_index_write_tree(git_oid *out, git_index *index);
 int git_index_write_tree_to(git_oid *out, git_index *index, git_repository *repo);
@@ -0,0 +1,7 @@
+int git_object_lookup(
+	git_object **object,
+	git_repository *repo,
+	const git_oid *id,
+	git_object_t type);
+
+void git_object_free(git_object *object);
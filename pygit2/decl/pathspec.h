@@ -0,0 +1,19 @@
+typedef struct git_pathspec git_pathspec;
+
+typedef enum {
+	GIT_PATHSPEC_DEFAULT        = 0,
+	GIT_PATHSPEC_IGNORE_CASE    = 1,
+	GIT_PATHSPEC_USE_CASE       = 2,
+	GIT_PATHSPEC_NO_GLOB        = 4,
+	GIT_PATHSPEC_NO_MATCH_ERROR = 8,
+	GIT_PATHSPEC_FIND_FAILURES  = 16,
+	GIT_PATHSPEC_FAILURES_ONLY  = 32,
+} git_pathspec_flag_t;
+
+int git_pathspec_new(
+	git_pathspec **out, const git_strarray *pathspec);
+
+void git_pathspec_free(git_pathspec *ps);
+
+int git_pathspec_matches_path(
+	const git_pathspec *ps, uint32_t flags, const char *path);
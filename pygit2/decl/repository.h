@@ -1,5 +1,6 @@
 #define GIT_REPOSITORY_INIT_OPTIONS_VERSION ...
 
+int git_repository_open(git_repository **out, const char *path);
 void git_repository_free(git_repository *repo);
 int git_repository_state_cleanup(git_repository *repo);
 int git_repository_config(git_config **out, git_repository *repo);
@@ -57,3 +58,9 @@ int git_repository_set_head_detached(
 int git_repository_ident(const char **name, const char **email, const git_repository *repo);
 int git_repository_set_ident(git_repository *repo, const char *name, const char *email);
 int git_repository_index(git_index **out, git_repository *repo);
+int git_repository_hashfile(
+	git_oid *out,
+	git_repository *repo,
+	const char *path,
+	git_object_t type,
+	const char *as_path);
@@ -1,3 +1,4 @@
+typedef struct git_blob git_blob;
 typedef struct git_commit git_commit;
 typedef struct git_config git_config;
 typedef struct git_index git_index;
@@ -14,6 +15,17 @@ typedef struct git_tree git_tree;
 typedef int64_t git_off_t;
 typedef int64_t git_time_t;
 
+typedef enum {
+	GIT_OBJECT_ANY =      -2,
+	GIT_OBJECT_INVALID =  -1,
+	GIT_OBJECT_COMMIT =    1,
+	GIT_OBJECT_TREE =      2,
+	GIT_OBJECT_BLOB =      3,
+	GIT_OBJECT_TAG =       4,
+	GIT_OBJECT_OFS_DELTA = 6,
+	GIT_OBJECT_REF_DELTA = 7,
+} git_object_t;
+
 typedef enum {
 	GIT_REFERENCE_INVALID  = 0,
 	GIT_REFERENCE_DIRECT   = 1,
@@ -23,12 +23,24 @@
 # the Free Software Foundation, 51 Franklin Street, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 
+from array import array
+from collections import namedtuple
+from itertools import groupby, repeat
+import os
+import stat
+import struct
 import weakref
 
 # Import from pygit2
 from ._pygit2 import Oid, Tree, Diff
+from ._pygit2 import GIT_FILEMODE_BLOB, GIT_FILEMODE_BLOB_EXECUTABLE
+from ._pygit2 import GIT_FILEMODE_LINK, GIT_FILEMODE_COMMIT
+from ._pygit2 import GIT_DELTA_DELETED, GIT_DELTA_UNTRACKED, GIT_DELTA_IGNORED
+from ._pygit2 import GIT_DIFF_INCLUDE_UNTRACKED, GIT_DIFF_RECURSE_UNTRACKED_DIRS
+from ._pygit2 import index_entries_table
 from .errors import check_error
 from .ffi import ffi, C
+from .pool import _RepositoryPool
 from .utils import to_bytes, to_str
 from .utils import GenericIterator, StrArray
 
@@ -96,6 +108,25 @@ class Index:
     def __iter__(self):
         return GenericIterator(self)
 
+    def entries_table(self):
+        """Return all the entries of the Index at once, as columns:
+
+        - paths: list of str
+        - modes: array('I') of GIT_FILEMODE_* values
+        - ids: bytes, the 20 bytes raw ids packed one after the other
+        - stages: array('B'), 0 unless the entry is a conflict
+        - sizes: array('I'), the file sizes (truncated to 32 bits)
+        - mtimes: array('q'), the modification times in nanoseconds
+
+        This reads the Index in a single native pass, without creating an
+        IndexEntry and an Oid object per entry as iterating does.
+        """
+        paths, modes, ids, stages, sizes, mtimes = index_entries_table(
+            self._pointer)
+        return EntriesTable(paths, _array('I', modes), ids,
+                            _array('B', stages), _array('I', sizes),
+                            _array('q', mtimes))
+
     def read(self, force=True):
         """
         Update the contents of the Index by reading from a file.
@@ -115,6 +146,22 @@ class Index:
         err = C.git_index_write(self._index)
         check_error(err, io=True)
 
+    @property
+    def version(self):
+        """The on-disk format version of the index file, 2, 3 or 4.
+
+        Version 4 compresses the paths against the previous entry, which
+        typically makes the index file of a large repository much smaller,
+        and each write() cheaper. The new version is used by the next
+        write().
+        """
+        return C.git_index_version(self._index)
+
+    @version.setter
+    def version(self, version):
+        err = C.git_index_set_version(self._index, version)
+        check_error(err)
+
     def clear(self):
         err = C.git_index_clear(self._index)
         check_error(err)
@@ -179,16 +226,140 @@ class Index:
             err = C.git_index_remove_all(self._index, arr, ffi.NULL, ffi.NULL)
             check_error(err, io=True)
 
-    def add_all(self, pathspecs=[]):
+    def add_all(self, pathspecs=[], threads=None):
         """Add or update index entries matching files in the working directory.
 
         If pathspecs are specified, only files matching those pathspecs will
         be added.
+
+        If threads is given, the working directory is stat'ed and the new
+        and modified files hashed on that many worker threads (0 means one
+        per CPU), instead of serially by libgit2.
         """
+        if threads is not None:
+            with _WorkdirScanner(self._repo, threads) as scanner:
+                return self._add_all_parallel(scanner, pathspecs)
+
         with StrArray(pathspecs) as arr:
             err = C.git_index_add_all(self._index, arr, 0, ffi.NULL, ffi.NULL)
             check_error(err, io=True)
 
+    def refresh(self, pathspecs=None, threads=None):
+        """Refresh the stat information of the entries whose file has been
+        touched but not modified, like ``git update-index --refresh``.
+
+        The working directory is stat'ed and the candidate files hashed on
+        'threads' worker threads (by default, or if 0, one per CPU). Later
+        calls to status or diff_to_workdir will then not need to hash these
+        files again. Only the Index in memory is updated, call write() to
+        save it.
+        """
+        with _WorkdirScanner(self._repo, threads) as scanner:
+            self._refresh(scanner, pathspecs, False)
+
+    def _refresh(self, scanner, pathspecs, add):
+        """Stat the (stage 0) file entries matching pathspecs, and hash the
+        ones whose stat information changed. If 'add' is False only the stat
+        information of unmodified files is updated, otherwise the modified
+        files are written to the object database and their entries updated,
+        and the entries of the deleted files removed.
+
+        A file replaced by something else than a file or a symbolic link (a
+        directory, for instance) is handled like a deleted file.
+        """
+        entries = []
+        with _Pathspec(pathspecs) as pathspec:
+            for i in range(len(self)):
+                centry = C.git_index_get_byindex(self._index, i)
+                if centry.flags & C.GIT_INDEX_ENTRY_STAGEMASK:
+                    continue
+                if centry.mode not in _WORKDIR_FILEMODES:
+                    continue
+                path = ffi.string(centry.path)
+                if not pathspec.matches(path):
+                    continue
+                entries.append(_EntrySnapshot(centry, path))
+
+        stats = scanner.lstat([entry.path for entry in entries])
+        dirty = []
+        for entry, st in zip(entries, stats):
+            if st is None or not _is_workdir_file(st):
+                if add:
+                    err = C.git_index_remove(self._index, entry.path, 0)
+                    check_error(err, io=True)
+            elif not entry.matches(st):
+                dirty.append((entry, st))
+
+        trust_mode = scanner.trust_mode
+        if not add:
+            # Symbolic links are left to libgit2, hashfile would follow them
+            dirty = [(e, st) for e, st in dirty if not stat.S_ISLNK(st.st_mode)]
+        oids = scanner.hash([entry.path for entry, st in dirty], write=add)
+        for (entry, st), oid in zip(dirty, oids):
+            if oid is None:
+                continue
+            if add:
+                mode = _filemode(st, trust_mode, entry.mode)
+            elif oid == entry.id:
+                mode = entry.mode
+            else:
+                continue
+            self._add_from_stat(entry.path, oid, mode, st, entry.flags_extended)
+
+    def _add_all_parallel(self, scanner, pathspecs):
+        # Update and remove the tracked files first, so the diff below finds
+        # nothing to hash and only reports what is left to do
+        self._refresh(scanner, pathspecs, True)
+
+        copts = ffi.new('git_diff_options *')
+        err = C.git_diff_init_options(copts, 1)
+        check_error(err)
+        copts.flags = GIT_DIFF_INCLUDE_UNTRACKED | GIT_DIFF_RECURSE_UNTRACKED_DIRS
+
+        with StrArray(pathspecs) as arr:
+            if arr != ffi.NULL:
+                copts.pathspec = arr[0]
+            cdiff = ffi.new('git_diff **')
+            err = C.git_diff_index_to_workdir(cdiff, self._repo._repo,
+                                              self._index, copts)
+            check_error(err)
+
+        diff = Diff.from_c(bytes(ffi.buffer(cdiff)[:]), self._repo)
+        untracked = []
+        for delta in diff.deltas:
+            path = to_bytes(delta.new_file.path)
+            if delta.status == GIT_DELTA_IGNORED:
+                continue
+            elif delta.status == GIT_DELTA_DELETED:
+                err = C.git_index_remove(self._index, path, 0)
+            elif delta.status == GIT_DELTA_UNTRACKED and not path.endswith(b'/'):
+                untracked.append(path)
+                continue
+            else:
+                # Conflicts, nested repositories, racily clean files...
+                err = C.git_index_add_bypath(self._index, path)
+            check_error(err, io=True)
+
+        stats = scanner.lstat(untracked)
+        oids = scanner.hash(untracked, write=True)
+        for path, st, oid in zip(untracked, stats, oids):
+            if st is None or oid is None:
+                continue
+            mode = _filemode(st, scanner.trust_mode, None)
+            self._add_from_stat(path, oid, mode, st, 0)
+
+    def _add_from_stat(self, path, oid, mode, st, flags_extended):
+        centry = ffi.new('git_index_entry *')
+        ffi.buffer(ffi.addressof(centry, 'id'))[:] = oid.raw[:]
+        centry.mode = mode
+        centry.flags_extended = flags_extended
+        _fill_stat(centry, st)
+        cpath = ffi.new('char[]', path)
+        centry.path = cpath
+
+        err = C.git_index_add(self._index, centry)
+        check_error(err, io=True)
+
     def add(self, path_or_entry):
         """Add or update an entry in the Index.
 
@@ -212,7 +383,98 @@ class Index:
 
         check_error(err, io=True)
 
-    def diff_to_workdir(self, flags=0, context_lines=3, interhunk_lines=0):
+    def add_entries(self, entries, oids=None, modes=None):
+        """Add or update many entries in the Index at once.
+
+        Either pass an iterable of IndexEntry objects, or the paths, ids and
+        modes of the entries as three sequences. The ids may be Oid objects,
+        hex strings or 20 bytes raw ids, or a single bytes object with the
+        raw ids packed one after the other; the modes may be a single int
+        shared by all the entries.
+
+        Only the path, id and mode of the IndexEntry objects are used, their
+        other fields (stat information, flags) are dropped. The new entries
+        replace all the existing ones for the same paths, conflict entries
+        included.
+
+        Adding entries one by one keeps the Index sorted on every insert,
+        here they are sorted once, appended in order to a new index and read
+        back in a single pass. The paths are checked for invalid components
+        such as '..' or '.git', but, unlike add() on the Index of a
+        repository with strict object creation enabled, the ids are not
+        checked to exist in the object database.
+        """
+        if oids is None:
+            rows = [(to_bytes(e.path), _raw_oid(e.id), e.mode) for e in entries]
+        else:
+            paths = list(entries)
+            if isinstance(oids, (bytes, bytearray, memoryview)):
+                oids = bytes(oids)
+                if len(oids) != 20 * len(paths):
+                    raise ValueError('expected %d packed ids' % len(paths))
+                oids = [oids[i:i + 20] for i in range(0, len(oids), 20)]
+            elif len(oids) != len(paths):
+                raise ValueError('expected %d ids' % len(paths))
+
+            if isinstance(modes, int):
+                modes = repeat(modes)
+            elif len(modes) != len(paths):
+                raise ValueError('expected %d modes' % len(paths))
+
+            rows = [(to_bytes(path), _raw_oid(oid), mode)
+                    for path, oid, mode in zip(paths, oids, modes)]
+
+        caps = C.git_index_caps(self._index)
+        if caps & C.GIT_INDEX_CAPABILITY_IGNORE_CASE:
+            key = lambda row: (row[0].lower(), row[1])
+        else:
+            key = lambda row: row[:2]
+
+        # (path, stage, entry): the existing entries are C pointers, the new
+        # ones (id, mode) tuples. The sort is stable, so the last row with a
+        # given path and stage wins, as it would with add().
+        rows = [(path, 0, (oid, mode)) for path, oid, mode in rows]
+
+        # Merge both into a new index, and read it back in one pass
+        new_paths = {path for path, stage, entry in rows}
+        existing = []
+        for i in range(len(self)):
+            centry = C.git_index_get_byindex(self._index, i)
+            path = ffi.string(centry.path)
+            if path not in new_paths:
+                stage = ((centry.flags & C.GIT_INDEX_ENTRY_STAGEMASK)
+                         >> C.GIT_INDEX_ENTRY_STAGESHIFT)
+                existing.append((path, stage, centry))
+        rows = existing + rows
+
+        cindex = ffi.new('git_index **')
+        err = C.git_index_open(cindex, ffi.NULL)
+        check_error(err)
+        target = cindex[0]
+
+        try:
+            err = C.git_index_set_caps(target, caps)
+            check_error(err)
+
+            rows.sort(key=key)
+            centry = ffi.new('git_index_entry *')
+            cid = ffi.buffer(ffi.addressof(centry, 'id'))
+            for path, stage, entry in rows:
+                if isinstance(entry, tuple):
+                    cid[:], centry.mode = entry
+                    cpath = ffi.new('char[]', path)
+                    centry.path = cpath
+                    entry = centry
+                err = C.git_index_add(target, entry)
+                check_error(err, io=True)
+
+            err = C.git_index_read_index(self._index, target)
+            check_error(err)
+        finally:
+            C.git_index_free(target)
+
+    def diff_to_workdir(self, flags=0, context_lines=3, interhunk_lines=0,
+                        threads=None):
         """
         Diff the index against the working directory. Return a <Diff> object
         with the differences between the index and the working copy.
@@ -229,11 +491,17 @@ class Index:
         interhunk_lines
             The maximum number of unchanged lines between hunk boundaries
             before the hunks will be merged into a one.
+
+        threads
+            If given, first refresh() the Index using that many threads.
         """
         repo = self._repo
         if repo is None:
             raise ValueError('diff needs an associated repository')
 
+        if threads is not None:
+            self.refresh(threads=threads)
+
         copts = ffi.new('git_diff_options *')
         err = C.git_diff_init_options(copts, 1)
         check_error(err)
@@ -296,6 +564,72 @@ class Index:
         return Diff.from_c(bytes(ffi.buffer(cdiff)[:]), repo)
 
 
+    #
+    # Extensions
+    #
+    @property
+    def extensions(self):
+        """The extensions of the index file on disk, a dict mapping their
+        signature (e.g. 'TREE', 'UNTR' or 'FSMN') to their raw data.
+
+        libgit2 does not use the untracked cache (UNTR) nor the file system
+        monitor (FSMN) extensions written by git, and drops them when it
+        writes the index; git will rebuild them on its next run.
+        """
+        cpath = C.git_index_path(self._index)
+        if cpath == ffi.NULL:
+            return {}
+
+        try:
+            with open(ffi.string(cpath), 'rb') as f:
+                data = f.read()
+        except FileNotFoundError:
+            return {}
+
+        return _read_extensions(data)
+
+    @property
+    def fsmonitor_token(self):
+        """The token of the last file system monitor (FSMN) query saved by
+        git in the index file, None if there is none.
+
+        Pass it to the file system monitor (e.g. watchman) to learn which
+        paths changed since, then use these as the 'paths' of
+        Repository.status() or Index.refresh() to skip everything else.
+        """
+        data = self.extensions.get('FSMN')
+        if data is None:
+            return None
+
+        version, = struct.unpack_from('>I', data)
+        if version == 1:
+            # Nanoseconds since the epoch
+            timestamp, = struct.unpack_from('>Q', data, 4)
+            return str(timestamp)
+
+        end = data.index(b'\0', 4)
+        return data[4:end].decode('utf-8')
+
+    @property
+    def tree_cache(self):
+        """The tree cache (TREE extension) of the index file on disk, a dict
+        mapping the directories ('' for the top level one) to the Oid of
+        their tree, or to None if the directory changed since it was cached.
+
+        read_tree() and write_tree() fill the cache, add() and remove()
+        invalidate the directories of the path, and write_tree() reuses the
+        trees of the valid ones. The hit ratio of the next write_tree() is::
+
+            >>> index.write()
+            >>> cache = index.tree_cache
+            >>> sum(oid is not None for oid in cache.values()) / len(cache)
+        """
+        data = self.extensions.get('TREE')
+        if not data:
+            return {}
+
+        return _read_tree_cache(data)
+
     #
     # Conflicts
     #
@@ -440,3 +774,383 @@ class ConflictIterator:
         theirs = IndexEntry._from_c(ctheirs[0])
 
         return ancestor, ours, theirs
+
+
+def _fill_stat(centry, st):
+    centry.ctime.seconds, centry.ctime.nanoseconds = divmod(st.st_ctime_ns, _NS)
+    centry.mtime.seconds, centry.mtime.nanoseconds = divmod(st.st_mtime_ns, _NS)
+    centry.dev = st.st_dev & 0xffffffff
+    centry.ino = st.st_ino & 0xffffffff
+    centry.uid = st.st_uid & 0xffffffff
+    centry.gid = st.st_gid & 0xffffffff
+    centry.file_size = st.st_size & 0xffffffff
+
+
+EntriesTable = namedtuple('EntriesTable',
+                          'paths modes ids stages sizes mtimes')
+
+
+def _array(typecode, data):
+    a = array(typecode)
+    a.frombytes(data)
+    return a
+
+
+def _raw_oid(oid):
+    if isinstance(oid, Oid):
+        return oid.raw
+    if isinstance(oid, str):
+        return Oid(hex=oid).raw
+    return bytes(oid)
+
+
+#
+# Index file extensions
+#
+def _decode_varint(data, pos):
+    """Decode the offset encoding of git's varint.c"""
+    c = data[pos]
+    pos += 1
+    value = c & 0x7f
+    while c & 0x80:
+        c = data[pos]
+        pos += 1
+        value = ((value + 1) << 7) | (c & 0x7f)
+    return value, pos
+
+
+def _read_extensions(data):
+    signature, version, count = struct.unpack_from('>4sII', data)
+    if signature != b'DIRC':
+        raise ValueError('not an index file')
+
+    # The extensions lie between the entries and the trailing checksum
+    end = len(data) - 20
+    pos = None
+
+    # git may write the offset of the first extension in the last one
+    eoie = end - 8 - 24
+    if eoie > 12 and data[eoie:eoie + 8] == b'EOIE\0\0\0\x18':
+        pos, = struct.unpack_from('>I', data, eoie + 8)
+
+    if pos is None:
+        pos = 12
+        for i in range(count):
+            flags, = struct.unpack_from('>H', data, pos + 60)
+            size = 62
+            if version >= 3 and flags & 0x4000:
+                size += 2
+            if version >= 4:
+                # Prefix compressed path, not padded
+                strip, path = _decode_varint(data, pos + size)
+                pos = data.index(b'\0', path) + 1
+                continue
+
+            length = flags & 0xfff
+            if length == 0xfff:
+                length = data.index(b'\0', pos + size) - pos - size
+            # 1 to 8 NUL bytes so the entry size is a multiple of 8
+            pos += (size + length + 8) & ~7
+
+    extensions = {}
+    while pos + 8 <= end:
+        signature, size = struct.unpack_from('>4sI', data, pos)
+        pos += 8
+        extensions[signature.decode('ascii')] = data[pos:pos + size]
+        pos += size
+
+    return extensions
+
+
+def _read_tree_cache(data):
+    cache = {}
+
+    def read_entry(pos, prefix):
+        end = data.index(b'\0', pos)
+        path = prefix + data[pos:end]
+        pos = end + 1
+        end = data.index(b'\n', pos)
+        entry_count, subtrees = data[pos:end].split(b' ')
+        pos = end + 1
+
+        # An entry count of -1 marks an invalidated directory
+        if int(entry_count) >= 0:
+            cache[to_str(path)] = Oid(raw=data[pos:pos + 20])
+            pos += 20
+        else:
+            cache[to_str(path)] = None
+
+        for i in range(int(subtrees)):
+            pos = read_entry(pos, path + b'/' if path else b'')
+        return pos
+
+    read_entry(0, b'')
+    return cache
+
+
+#
+# Parallel working directory scan
+#
+_NS = 1000000000
+_WORKDIR_FILEMODES = (GIT_FILEMODE_BLOB, GIT_FILEMODE_BLOB_EXECUTABLE,
+                      GIT_FILEMODE_LINK)
+
+
+def _is_workdir_file(st):
+    return stat.S_ISREG(st.st_mode) or stat.S_ISLNK(st.st_mode)
+
+
+def _filemode(st, trust_mode, old_mode):
+    if stat.S_ISLNK(st.st_mode):
+        return GIT_FILEMODE_LINK
+
+    if not trust_mode and old_mode in (GIT_FILEMODE_BLOB,
+                                       GIT_FILEMODE_BLOB_EXECUTABLE):
+        return old_mode
+
+    if st.st_mode & stat.S_IXUSR:
+        return GIT_FILEMODE_BLOB_EXECUTABLE
+    return GIT_FILEMODE_BLOB
+
+
+class _EntrySnapshot:
+    """The bits of an index entry needed to tell whether its file changed.
+
+    The C entry cannot be kept, as it is freed when the Index is modified.
+    """
+    __slots__ = ['path', 'id', 'mode', 'mtime', 'size', 'flags_extended']
+
+    def __init__(self, centry, path):
+        self.path = path
+        self.id = Oid(raw=bytes(ffi.buffer(ffi.addressof(centry, 'id'))[:]))
+        self.mode = centry.mode
+        self.mtime = (centry.mtime.seconds, centry.mtime.nanoseconds)
+        self.size = centry.file_size
+        self.flags_extended = centry.flags_extended
+
+    def matches(self, st):
+        if stat.S_ISLNK(st.st_mode) != (self.mode == GIT_FILEMODE_LINK):
+            return False
+
+        if self.size != st.st_size & 0xffffffff:
+            return False
+
+        seconds, nanoseconds = divmod(st.st_mtime_ns, _NS)
+        # libgit2 may have been built without nanosecond support
+        return self.mtime in ((seconds, nanoseconds), (seconds, 0))
+
+
+class _Pathspec:
+
+    def __init__(self, pathspecs):
+        self._pathspecs = pathspecs
+        self._ps = None
+
+    def __enter__(self):
+        if self._pathspecs:
+            with StrArray(self._pathspecs) as arr:
+                cps = ffi.new('git_pathspec **')
+                err = C.git_pathspec_new(cps, arr)
+                check_error(err)
+                self._ps = cps[0]
+        return self
+
+    def __exit__(self, type, value, traceback):
+        if self._ps is not None:
+            C.git_pathspec_free(self._ps)
+            self._ps = None
+
+    def matches(self, path):
+        if self._ps is None:
+            return True
+        return C.git_pathspec_matches_path(self._ps, 0, path) == 1
+
+
+class _WorkdirScanner(_RepositoryPool):
+    """Stat and hash working directory files on a pool of threads.
+
+    os.lstat releases the GIL too.
+    """
+
+    def __init__(self, repo, threads, workdir=None):
+        if repo is None:
+            raise ValueError('workdir scan needs an associated repository')
+        workdir = workdir or repo.workdir
+        if workdir is None:
+            raise ValueError('workdir scan needs a working directory')
+
+        super().__init__(repo, threads)
+        self._workdir = os.path.join(to_bytes(workdir), b'')
+
+        try:
+            self.trust_mode = repo.config.get_bool('core.filemode')
+        except KeyError:
+            self.trust_mode = True
+
+        try:
+            self.symlinks = repo.config.get_bool('core.symlinks')
+        except KeyError:
+            self.symlinks = True
+
+    def _map(self, fn, paths, path=lambda item: item, done=None):
+        """Call fn on the paths, one task per directory, and return the
+        results in the order of the paths. The items of 'paths' may be tuples
+        too, 'path' then returns the path of an item.
+
+        If given, done is called from the calling thread with every batch
+        once it has been processed, in order.
+        """
+        dirname = lambda item: path(item).rpartition(b'/')[0]
+        batches = [list(group) for key, group in groupby(paths, key=dirname)]
+        results = []
+        tasks = [self._executor.submit(fn, batch) for batch in batches]
+        for batch, task in zip(batches, tasks):
+            results.extend(task.result())
+            if done is not None:
+                done(batch)
+        return results
+
+    def lstat(self, paths):
+        """Return the os.lstat() results of the given paths, None for the
+        missing files."""
+        workdir = self._workdir
+
+        def lstat_batch(batch):
+            results = []
+            for path in batch:
+                try:
+                    results.append(os.lstat(workdir + path))
+                except (FileNotFoundError, NotADirectoryError):
+                    results.append(None)
+            return results
+
+        return self._map(lstat_batch, paths)
+
+    def hash(self, paths, write=False):
+        """Return the blob ids of the given files, with filters applied,
+        None for the files that vanished. If write is True the blobs are
+        written to the object database as well.
+        """
+
+        def hash_batch(batch):
+            crepo = self._crepo()
+            results = []
+            for path in batch:
+                coid = ffi.new('git_oid *')
+                if write:
+                    err = C.git_blob_create_from_workdir(coid, crepo, path)
+                else:
+                    err = C.git_repository_hashfile(coid, crepo, path,
+                                                    C.GIT_OBJECT_BLOB, ffi.NULL)
+                if err == C.GIT_ENOTFOUND:
+                    results.append(None)
+                    continue
+                check_error(err, io=True)
+                results.append(Oid(raw=bytes(ffi.buffer(coid)[:])))
+            return results
+
+        return self._map(hash_batch, paths)
+
+    def checkout(self, entries, callbacks=None):
+        """Write the (path, raw id, mode) entries below the working
+        directory, with filters applied, and return a dict mapping their
+        paths to the os.lstat() results of the written files.
+
+        The .gitattributes files are written first, as they may change the
+        filters of the others, and the symbolic links last. The methods of
+        the CheckoutCallbacks, if any, are called from the calling thread.
+        """
+        workdir = self._workdir
+        symlinks = self.symlinks
+        mkdir_calls = []
+        completed = 0
+
+        def write_batch(batch):
+            crepo = self._crepo()
+            dirname = workdir + batch[0][0].rpartition(b'/')[0]
+            if not os.path.isdir(dirname):
+                os.makedirs(dirname, exist_ok=True)
+                mkdir_calls.append(dirname)
+            results = []
+            for path, raw, mode in batch:
+                dest = workdir + path
+                if mode == GIT_FILEMODE_COMMIT:
+                    # Submodules are left empty, as libgit2 does
+                    os.mkdir(dest)
+                    mkdir_calls.append(dest)
+                    results.append(None)
+                    continue
+
+                cblob = ffi.new('git_blob **')
+                coid = ffi.new('git_oid *')
+                ffi.buffer(coid)[:] = raw
+                err = C.git_blob_lookup(cblob, crepo, coid)
+                check_error(err)
+                try:
+                    if mode == GIT_FILEMODE_LINK:
+                        target = ffi.buffer(C.git_blob_rawcontent(cblob[0]),
+                                            C.git_blob_rawsize(cblob[0]))
+                        if symlinks:
+                            os.symlink(target[:], dest)
+                        else:
+                            _write_file(dest, target, mode)
+                    else:
+                        cbuf = ffi.new('git_buf *')
+                        # Binary files are filtered too, as libgit2 does
+                        err = C.git_blob_filtered_content(cbuf, cblob[0],
+                                                          path, 0)
+                        check_error(err)
+                        try:
+                            _write_file(dest, ffi.buffer(cbuf.ptr, cbuf.size),
+                                        mode)
+                        finally:
+                            C.git_buf_dispose(cbuf)
+                finally:
+                    C.git_blob_free(cblob[0])
+
+                results.append(os.lstat(dest))
+            return results
+
+        attributes, files, links = [], [], []
+        for entry in entries:
+            if entry[2] == GIT_FILEMODE_LINK:
+                links.append(entry)
+            elif entry[0].rpartition(b'/')[2] == b'.gitattributes':
+                attributes.append(entry)
+            else:
+                files.append(entry)
+
+        def done(batch):
+            nonlocal completed
+            for entry in batch:
+                completed += 1
+                callbacks.checkout_progress(to_str(entry[0]), completed,
+                                            len(entries))
+
+        if callbacks is not None:
+            callbacks.checkout_progress(None, 0, len(entries))
+        else:
+            done = None
+
+        stats = {}
+        for batch in (attributes, files):
+            results = self._map(write_batch, batch,
+                                path=lambda entry: entry[0], done=done)
+            stats.update(zip([entry[0] for entry in batch], results))
+        for entry in links:
+            stats[entry[0]] = write_batch([entry])[0]
+            if done is not None:
+                done([entry])
+
+        if callbacks is not None:
+            stat_calls = sum(st is not None for st in stats.values())
+            callbacks.checkout_perfdata(len(mkdir_calls), stat_calls, 0)
+
+        return stats
+
+
+def _write_file(path, data, mode):
+    perms = 0o777 if mode == GIT_FILEMODE_BLOB_EXECUTABLE else 0o666
+    flags = os.O_WRONLY | os.O_CREAT | os.O_EXCL | getattr(os, 'O_BINARY', 0)
+    with open(os.open(path, flags, perms), 'wb') as f:
+        f.write(data)
@@ -0,0 +1,85 @@
+# Copyright 2010-2020 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+# Import from the Standard Library
+from concurrent.futures import ThreadPoolExecutor
+import os
+import threading
+
+# Import from pygit2
+from .errors import check_error
+from .ffi import ffi, C
+from .utils import to_bytes
+
+
+class _RepositoryPool:
+    """A pool of threads, each with its own handle on the repository.
+
+    A git_repository cannot be shared between threads, so every worker
+    opens its own. The GIL is released by the libgit2 calls, so the work
+    really runs in parallel.
+    """
+
+    def __init__(self, repo, threads):
+        self._path = to_bytes(repo.path)
+        self._threads = threads or os.cpu_count() or 1
+        self._local = threading.local()
+        self._lock = threading.Lock()
+        self._repos = []
+        self._executor = None
+
+    def __enter__(self):
+        self._executor = ThreadPoolExecutor(max_workers=self._threads)
+        return self
+
+    def __exit__(self, type, value, traceback):
+        self._executor.shutdown()
+        self._executor = None
+        for crepo in self._repos:
+            C.git_repository_free(crepo)
+        self._repos = []
+
+    def _crepo(self):
+        crepo = getattr(self._local, 'repo', None)
+        if crepo is None:
+            cptr = ffi.new('git_repository **')
+            err = C.git_repository_open(cptr, self._path)
+            check_error(err)
+            crepo = self._local.repo = cptr[0]
+            with self._lock:
+                self._repos.append(crepo)
+
+        return crepo
+
+    def _map_batches(self, fn, items):
+        """Call fn on batches of the items, a few per thread so every
+        repository handle keeps its object cache warm, and return the
+        results in the order of the items."""
+        size = -(-len(items) // (self._threads * 4)) or 1
+        batches = [items[i:i + size] for i in range(0, len(items), size)]
+        results = []
+        for result in self._executor.map(fn, batches):
+            results.extend(result)
+        return results
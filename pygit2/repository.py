@@ -24,33 +24,137 @@
 # Boston, MA 02110-1301, USA.
 
 # Import from the Standard Library
+from collections import deque, namedtuple
+from concurrent.futures import ThreadPoolExecutor
 from io import BytesIO
+from itertools import chain
+import os
 from string import hexdigits
+import struct
 import tarfile
 from time import time
 import warnings
+import zlib
 
 # Import from pygit2
 from ._pygit2 import Repository as _Repository, init_file_backend
 from ._pygit2 import Oid, GIT_OID_HEXSZ, GIT_OID_MINPREFIXLEN
 from ._pygit2 import GIT_CHECKOUT_SAFE, GIT_CHECKOUT_RECREATE_MISSING, GIT_DIFF_NORMAL
+from ._pygit2 import GIT_CHECKOUT_DISABLE_PATHSPEC_MATCH, GIT_OBJ_TREE
+from ._pygit2 import GIT_CHECKOUT_FORCE, GIT_CHECKOUT_DONT_UPDATE_INDEX
 from ._pygit2 import GIT_FILEMODE_LINK
 from ._pygit2 import GIT_BRANCH_LOCAL, GIT_BRANCH_REMOTE, GIT_BRANCH_ALL
 from ._pygit2 import GIT_REF_SYMBOLIC
+from ._pygit2 import GIT_SORT_TOPOLOGICAL, GIT_SORT_REVERSE
 from ._pygit2 import Reference, Tree, Commit, Blob
 from ._pygit2 import InvalidSpecError
 
-from .callbacks import git_fetch_options
+from .callbacks import git_fetch_options, git_checkout_callbacks
 from .config import Config
 from .errors import check_error
 from .ffi import ffi, C
-from .index import Index
+from .index import Index, _WorkdirScanner
+from .pool import _RepositoryPool
 from .remote import RemoteCollection
 from .blame import Blame
-from .utils import to_bytes, StrArray
+from .utils import to_bytes, to_str, StrArray
 from .submodule import Submodule
 
 
+ReplayResult = namedtuple('ReplayResult', 'commits tree stopped_at conflicts')
+
+# Formats of Repository._write_archive
+_ARCHIVE_TAR, _ARCHIVE_TAR_GZ, _ARCHIVE_ZIP = range(3)
+_ARCHIVE_FORMATS = {'tar': _ARCHIVE_TAR, 'tar.gz': _ARCHIVE_TAR_GZ,
+                    'tgz': _ARCHIVE_TAR_GZ, 'zip': _ARCHIVE_ZIP}
+
+
+class _ParallelGzipWriter:
+    """A writable compressing to gzip on a pool of threads.
+
+    The data is cut into blocks deflated independently, each primed with
+    the end of the previous one, and flushed to a byte boundary so they
+    can be concatenated into a single deflate stream, like pigz does. zlib
+    releases the GIL, so the blocks are really compressed in parallel,
+    while the caller keeps producing data.
+    """
+
+    BLOCK_SIZE = 128 * 1024
+    WINDOW_SIZE = 32 * 1024
+
+    def __init__(self, output, level, threads, mtime):
+        self._output = output
+        self._level = level
+        self._threads = threads or os.cpu_count() or 1
+        self._executor = None
+        self._pending = deque()
+        self._buf = bytearray()
+        self._window = b''
+        self._crc = 0
+        self._size = 0
+        self._mtime = mtime
+
+    def __enter__(self):
+        self._executor = ThreadPoolExecutor(max_workers=self._threads)
+        xfl = {1: 4, 9: 2}.get(self._level, 0)
+        self._write(struct.pack('<BBBBIBB', 0x1f, 0x8b, 8, 0,
+                                self._mtime & 0xffffffff, xfl, 255))
+        return self
+
+    def __exit__(self, type, value, traceback):
+        try:
+            if type is None:
+                self._submit(bytes(self._buf), True)
+                while self._pending:
+                    self._write(self._pending.popleft().result())
+                self._write(struct.pack('<II', self._crc,
+                                        self._size & 0xffffffff))
+        finally:
+            self._executor.shutdown()
+            self._executor = None
+
+    def _write(self, data):
+        # Raw files may write less than asked
+        view = memoryview(data)
+        while view:
+            n = self._output.write(view)
+            if n is None:
+                break
+            if n <= 0:
+                raise OSError('write() did not write any data')
+            view = view[n:]
+
+    def _compress(self, block, window, last):
+        if window:
+            compressor = zlib.compressobj(self._level, zlib.DEFLATED,
+                                          -zlib.MAX_WBITS, zdict=window)
+        else:
+            compressor = zlib.compressobj(self._level, zlib.DEFLATED,
+                                          -zlib.MAX_WBITS)
+        data = compressor.compress(block)
+        return data + compressor.flush(zlib.Z_FINISH if last
+                                       else zlib.Z_SYNC_FLUSH)
+
+    def _submit(self, block, last):
+        self._pending.append(self._executor.submit(self._compress, block,
+                                                   self._window, last))
+        self._window = block[-self.WINDOW_SIZE:]
+
+        # Bound the memory held by blocks waiting to be written
+        while len(self._pending) > self._threads * 2:
+            self._write(self._pending.popleft().result())
+
+    def write(self, data):
+        self._crc = zlib.crc32(data, self._crc)
+        self._size += len(data)
+        self._buf += data
+        while len(self._buf) >= self.BLOCK_SIZE:
+            block = bytes(self._buf[:self.BLOCK_SIZE])
+            del self._buf[:self.BLOCK_SIZE]
+            self._submit(block, False)
+        return len(data)
+
+
 class BaseRepository(_Repository):
     def __init__(self, *args, **kwargs):
         super().__init__(*args, **kwargs)
@@ -228,7 +332,8 @@ class BaseRepository(_Repository):
     # Checkout
     #
     @staticmethod
-    def _checkout_args_to_options(strategy=None, directory=None, paths=None):
+    def _checkout_args_to_options(strategy=None, directory=None, paths=None,
+                                  callbacks=None):
         # Create the options struct to pass
         copts = ffi.new('git_checkout_options *')
         check_error(C.git_checkout_init_options(copts, 1))
@@ -252,34 +357,183 @@ class BaseRepository(_Repository):
             refs.append(strarray)
             copts.paths = strarray.array[0]
 
+        if callbacks is not None:
+            refs.append(git_checkout_callbacks(callbacks, copts))
+
         return copts, refs
 
-    def checkout_head(self, **kwargs):
+    @staticmethod
+    def _checkout_check_error(err, callbacks=None):
+        # Exceptions raised by the callbacks cannot stop libgit2
+        if callbacks is not None and callbacks._stored_exception is not None:
+            raise callbacks._stored_exception
+        check_error(err)
+
+    def _sparse_checkout_args(self, sparse, kwargs, tree=None, index=None):
+        """Turn the 'sparse' argument into the literal list of paths to
+        checkout: the cone directories, and the files directly within each
+        of their parent directories (the top level one included).
+
+        Only the parent directories of 'tree' are listed, the cone ones are
+        left to libgit2, which skips the subtrees matching no path.
+        """
+        if kwargs.get('paths'):
+            raise ValueError('paths and sparse cannot be given together')
+
+        if sparse is True:
+            sparse = self.sparse_checkout_cone()
+            if sparse is None:
+                return kwargs
+        cone = {to_str(path).strip('/') for path in sparse}
+        if '' in cone:
+            return kwargs
+
+        parents = {''}
+        for path in cone:
+            parts = path.split('/')
+            parents.update('/'.join(parts[:i]) for i in range(1, len(parts)))
+
+        paths = sorted(cone)
+        if tree is not None:
+            for parent in sorted(parents):
+                try:
+                    subtree = tree[parent] if parent else tree
+                except KeyError:
+                    continue
+                if subtree.type != GIT_OBJ_TREE:
+                    continue
+                prefix = parent + '/' if parent else ''
+                paths.extend(prefix + obj.name for obj in subtree
+                             if obj.type != GIT_OBJ_TREE)
+        else:
+            for path in index.entries_table().paths:
+                if path.rpartition('/')[0] in parents:
+                    paths.append(path)
+
+        strategy = kwargs.get('strategy') or (GIT_CHECKOUT_SAFE |
+                                              GIT_CHECKOUT_RECREATE_MISSING)
+        kwargs['strategy'] = strategy | GIT_CHECKOUT_DISABLE_PATHSPEC_MATCH
+        kwargs['paths'] = paths
+        return kwargs
+
+    def sparse_checkout_cone(self):
+        """Return the directories of the cone mode sparse-checkout file
+        ($GIT_DIR/info/sparse-checkout), as written by
+        ``git sparse-checkout set``, or None if there is no such file.
+        """
+        path = os.path.join(self.path, 'info', 'sparse-checkout')
+        try:
+            with open(path, encoding='utf-8') as f:
+                lines = [line.strip() for line in f]
+        except FileNotFoundError:
+            return None
+
+        included, parents = set(), set()
+        for line in lines:
+            if not line or line.startswith('#') or line == '/*':
+                continue
+            if line.startswith('!/') and line.endswith('/*/'):
+                parents.add(line[2:-3])
+            elif line.startswith('/') and line.endswith('/'):
+                included.add(line[1:-1])
+            elif line != '!/*/':
+                raise ValueError('not a cone mode pattern: %s' % line)
+
+        return sorted(included - parents)
+
+    def _checkout_parallel(self, tree, threads, strategy=None, directory=None,
+                           paths=None, callbacks=None):
+        """Checkout 'tree' into a fresh working directory, inflating and
+        writing the files on a pool of threads. Return False without doing
+        anything when the checkout is left to libgit2: for a subset of the
+        paths, for a dry run, or when any top level entry of the tree is
+        already there, as only libgit2 knows how to update files safely.
+        """
+        workdir = directory or self.workdir
+        if paths or workdir is None:
+            return False
+
+        strategy = strategy or (GIT_CHECKOUT_SAFE | GIT_CHECKOUT_RECREATE_MISSING)
+        if not strategy & (GIT_CHECKOUT_SAFE | GIT_CHECKOUT_FORCE |
+                           GIT_CHECKOUT_RECREATE_MISSING):
+            return False
+
+        for obj in tree:
+            if os.path.lexists(os.path.join(workdir, obj.name)):
+                return False
+
+        # The repository index describes its own working directory only
+        update_index = (directory is None and
+                        not strategy & GIT_CHECKOUT_DONT_UPDATE_INDEX)
+        index = self.index if update_index else Index()
+        index.read_tree(tree)
+        table = index.entries_table()
+        entries = [(to_bytes(path), table.ids[i * 20:i * 20 + 20], mode)
+                   for i, (path, mode) in enumerate(zip(table.paths, table.modes))]
+
+        with _WorkdirScanner(self, threads, workdir) as scanner:
+            stats = scanner.checkout(entries, callbacks)
+
+        if update_index:
+            # Record the stat information, so the files are not hashed again
+            for path, raw, mode in entries:
+                st = stats[path]
+                if st is not None:
+                    index._add_from_stat(path, Oid(raw=raw), mode, st, 0)
+            # Then build the tree cache invalidated by these updates again;
+            # the trees are those of 'tree', so nothing is written
+            index.write_tree()
+            index.write()
+
+        return True
+
+    def checkout_head(self, threads=None, **kwargs):
         """Checkout HEAD
 
         For arguments, see Repository.checkout().
         """
+        sparse = kwargs.pop('sparse', None)
+        if sparse:
+            kwargs = self._sparse_checkout_args(sparse, kwargs,
+                                                tree=self.head.peel(Tree))
+        elif threads is not None:
+            if self._checkout_parallel(self.head.peel(Tree), threads, **kwargs):
+                return
         copts, refs = Repository._checkout_args_to_options(**kwargs)
-        check_error(C.git_checkout_head(self._repo, copts))
+        err = C.git_checkout_head(self._repo, copts)
+        Repository._checkout_check_error(err, kwargs.get('callbacks'))
 
-    def checkout_index(self, index=None, **kwargs):
+    def checkout_index(self, index=None, threads=None, **kwargs):
         """Checkout the given index or the repository's index
 
         For arguments, see Repository.checkout().
         """
+        sparse = kwargs.pop('sparse', None)
+        if sparse:
+            kwargs = self._sparse_checkout_args(sparse, kwargs,
+                                                index=index or self.index)
         copts, refs = Repository._checkout_args_to_options(**kwargs)
-        check_error(C.git_checkout_index(self._repo, index._index if index else ffi.NULL, copts))
+        err = C.git_checkout_index(self._repo, index._index if index else ffi.NULL, copts)
+        Repository._checkout_check_error(err, kwargs.get('callbacks'))
 
-    def checkout_tree(self, treeish, **kwargs):
+    def checkout_tree(self, treeish, threads=None, **kwargs):
         """Checkout the given treeish
 
         For arguments, see Repository.checkout().
         """
+        sparse = kwargs.pop('sparse', None)
+        if sparse:
+            kwargs = self._sparse_checkout_args(sparse, kwargs,
+                                                tree=treeish.peel(Tree))
+        elif threads is not None:
+            if self._checkout_parallel(treeish.peel(Tree), threads, **kwargs):
+                return
         copts, refs = Repository._checkout_args_to_options(**kwargs)
         cptr = ffi.new('git_object **')
         ffi.buffer(cptr)[:] = treeish._pointer[:]
 
-        check_error(C.git_checkout_tree(self._repo, cptr[0], copts))
+        err = C.git_checkout_tree(self._repo, cptr[0], copts)
+        Repository._checkout_check_error(err, kwargs.get('callbacks'))
 
     def checkout(self, refname=None, **kwargs):
         """
@@ -306,6 +560,23 @@ class BaseRepository(_Repository):
             A list of files to checkout from the given reference.
             If paths is provided, HEAD will not be set to the reference.
 
+        callbacks : CheckoutCallbacks
+            Object whose methods are called to report the progress and the
+            performance data of the checkout.
+
+        sparse : list[str] or True
+            Only checkout these directories, and the files directly within
+            their parent directories, like a cone mode sparse-checkout. True
+            reads the directories from $GIT_DIR/info/sparse-checkout. The
+            files outside of the cone are left untouched.
+
+        threads : int
+            When checking out HEAD or a reference into a working directory
+            where none of the top level files and directories exist yet
+            (a fresh clone or worktree), inflate and write the files on
+            that many threads (0 means one per CPU). Otherwise libgit2 does
+            the checkout as usual.
+
         Examples:
 
         * To checkout from the HEAD, just pass 'HEAD'::
@@ -476,6 +747,40 @@ class BaseRepository(_Repository):
 
         raise ValueError("Only blobs and treeish can be diffed")
 
+    #
+    # Status
+    #
+    _threads_doc = """
+threads
+    If given, the index is first refreshed on that many worker threads (0
+    means one per CPU), so the files which were touched but not modified are
+    not hashed serially by libgit2. See Index.refresh().
+
+    Note this updates the stat information of these entries in the
+    repository's index, repo.index, as a side effect. The change is only in
+    memory until the index is written, or read again from the disk.
+"""
+
+    def _refresh_index(self, threads, paths=None, *args, **kwargs):
+        if threads is not None:
+            self.index.refresh(paths, threads)
+
+    def status(self, *args, threads=None, **kwargs):
+        self._refresh_index(threads, *args, **kwargs)
+        return super().status(*args, **kwargs)
+
+    def status_iter(self, *args, threads=None, **kwargs):
+        self._refresh_index(threads, *args, **kwargs)
+        return super().status_iter(*args, **kwargs)
+
+    def is_dirty(self, *args, threads=None, **kwargs):
+        self._refresh_index(threads, *args, **kwargs)
+        return super().is_dirty(*args, **kwargs)
+
+    status.__doc__ = _Repository.status.__doc__ + _threads_doc
+    status_iter.__doc__ = _Repository.status_iter.__doc__ + _threads_doc
+    is_dirty.__doc__ = _Repository.is_dirty.__doc__ + _threads_doc
+
     def state_cleanup(self):
         """Remove all the metadata associated with an ongoing command like
         merge, revert, cherry-pick, etc. For example: MERGE_HEAD, MERGE_MSG,
@@ -486,6 +791,30 @@ class BaseRepository(_Repository):
     #
     # blame
     #
+    def _blame_options(self, flags=None, min_match_characters=None,
+                       newest_commit=None, oldest_commit=None, min_line=None,
+                       max_line=None):
+        options = ffi.new('git_blame_options *')
+        C.git_blame_init_options(options, C.GIT_BLAME_OPTIONS_VERSION)
+        if flags:
+            options.flags = flags
+        if min_match_characters:
+            options.min_match_characters = min_match_characters
+        if newest_commit:
+            if not isinstance(newest_commit, Oid):
+                newest_commit = Oid(hex=newest_commit)
+            ffi.buffer(ffi.addressof(options, 'newest_commit'))[:] = newest_commit.raw
+        if oldest_commit:
+            if not isinstance(oldest_commit, Oid):
+                oldest_commit = Oid(hex=oldest_commit)
+            ffi.buffer(ffi.addressof(options, 'oldest_commit'))[:] = oldest_commit.raw
+        if min_line:
+            options.min_line = min_line
+        if max_line:
+            options.max_line = max_line
+
+        return options
+
     def blame(self, path, flags=None, min_match_characters=None,
               newest_commit=None, oldest_commit=None, min_line=None,
               max_line=None):
@@ -521,28 +850,117 @@ class BaseRepository(_Repository):
             repo.blame('foo.c', flags=GIT_BLAME_TRACK_COPIES_SAME_FILE)
         """
 
-        options = ffi.new('git_blame_options *')
-        C.git_blame_init_options(options, C.GIT_BLAME_OPTIONS_VERSION)
-        if min_match_characters:
-            options.min_match_characters = min_match_characters
-        if newest_commit:
-            if not isinstance(newest_commit, Oid):
-                newest_commit = Oid(hex=newest_commit)
-            ffi.buffer(ffi.addressof(options, 'newest_commit'))[:] = newest_commit.raw
-        if oldest_commit:
-            if not isinstance(oldest_commit, Oid):
-                oldest_commit = Oid(hex=oldest_commit)
-            ffi.buffer(ffi.addressof(options, 'oldest_commit'))[:] = oldest_commit.raw
-        if min_line:
-            options.min_line = min_line
-        if max_line:
-            options.max_line = max_line
+        options = self._blame_options(flags, min_match_characters,
+                                      newest_commit, oldest_commit, min_line,
+                                      max_line)
 
         cblame = ffi.new('git_blame **')
         err = C.git_blame_file(cblame, self._repo, to_bytes(path), options)
         check_error(err)
 
-        return Blame._from_c(self, cblame[0])
+        # What Blame.update needs to reuse this blame, unless it is partial
+        if oldest_commit or min_line or max_line:
+            newest_commit = None
+        elif not newest_commit:
+            newest_commit = self.head.target
+        elif not isinstance(newest_commit, Oid):
+            newest_commit = Oid(hex=newest_commit)
+        kwargs = {'flags': flags, 'min_match_characters': min_match_characters}
+        return Blame._from_c(self, cblame[0], path, newest_commit, kwargs)
+
+    def blame_iter(self, path, first_line=None, step=100, newest_commit=None,
+                   min_line=None, max_line=None, **kwargs):
+        """
+        Yield the BlameHunk objects of a file progressively, blaming
+        ``step`` lines at a time, starting at ``first_line`` (by default the
+        first line) and wrapping around to the lines before it.
+
+        This lets a viewer paint the lines on screen as soon as they are
+        resolved, instead of waiting for the blame of the whole file. The
+        total work is higher than a single blame, and a hunk crossing two
+        ranges is yielded in two parts.
+
+        The other parameters are those of blame(). The newest commit,
+        by default HEAD, is resolved once so all the ranges see the same
+        history.
+
+        Examples::
+
+            for hunk in repo.blame_iter('foo.c', first_line=top, step=50):
+                paint(hunk)
+        """
+        if newest_commit:
+            commit = self[newest_commit].peel(Commit)
+        else:
+            commit = self.head.peel(Commit)
+
+        data = self[commit.tree[path].id].data
+        count = data.count(b'\n')
+        if data and not data.endswith(b'\n'):
+            count += 1
+
+        min_line = min_line or 1
+        max_line = min(max_line or count, count)
+        if first_line is None or not min_line <= first_line <= max_line:
+            first_line = min_line
+
+        starts = chain(range(first_line, max_line + 1, step),
+                       range(min_line, first_line, step))
+        for start in starts:
+            stop = max_line if start >= first_line else first_line - 1
+            blame = self.blame(path, newest_commit=commit.id, min_line=start,
+                               max_line=min(start + step - 1, stop), **kwargs)
+            for hunk in blame:
+                yield hunk
+
+    def blame_many(self, paths, newest_commit=None, threads=None, flags=None,
+                   min_match_characters=None, oldest_commit=None):
+        """
+        Blame many files at the same commit on a pool of threads, and return
+        a dict mapping every path to its Blame.hunks_table().
+
+        Every thread opens its own handle on the repository and blames a
+        batch of files at a time, so the commits and trees loaded for one
+        file stay in its object cache for the next ones.
+
+        Parameters:
+
+        paths
+            The paths of the files to blame.
+
+        newest_commit
+            The commit to blame the files at, by default HEAD.
+
+        threads
+            The number of threads, by default the number of CPUs.
+
+        The other parameters are those of blame().
+        """
+        if newest_commit:
+            commit = self[newest_commit].peel(Commit).id
+        else:
+            commit = self.head.peel(Commit).id
+
+        def blame_batch(batch):
+            crepo = pool._crepo()
+            options = self._blame_options(flags, min_match_characters, commit,
+                                          oldest_commit)
+            cblame = ffi.new('git_blame **')
+            tables = []
+            for path in batch:
+                err = C.git_blame_file(cblame, crepo, to_bytes(path), options)
+                check_error(err)
+                # Freed right away, on the thread owning its repository
+                blame = Blame._from_c(self, cblame[0])
+                tables.append(blame.hunks_table())
+                del blame
+            return tables
+
+        paths = list(paths)
+        with _RepositoryPool(self, threads) as pool:
+            tables = pool._map_batches(blame_batch, paths)
+
+        return dict(zip(paths, tables))
 
     #
     # Index
@@ -726,6 +1144,116 @@ class BaseRepository(_Repository):
 
         return Index.from_c(self, cindex)
 
+    def _object_ids(self, objs):
+        ids = []
+        for obj in objs:
+            if obj is not None and not isinstance(obj, (str, Oid)):
+                obj = obj.id
+            ids.append(obj)
+        return ids
+
+    def merge_check(self, ancestor, ours, theirs, favor='normal'):
+        """
+        Merge three trees in memory and tell whether the merge is clean,
+        without building an Index object.
+
+        Returns: a tuple (clean, conflicts, tree_id). When the merge is
+        clean, conflicts is empty and tree_id is the id of the merged tree,
+        which is written to the object database. Otherwise conflicts lists
+        the conflicting paths and tree_id is None.
+
+        The parameters are those of merge_trees(); each tree may be given
+        as any object which peels to a tree, or its id. The ancestor may
+        be None.
+        """
+        file_favor = self._merge_options(favor).file_favor
+        ancestor, ours, theirs = self._object_ids((ancestor, ours, theirs))
+        return self._merge_check(ancestor, ours, theirs, file_favor)
+
+    def merge_check_many(self, triples, favor='normal', threads=None):
+        """
+        Check many merges on a pool of threads, and return the results of
+        merge_check() for every (ancestor, ours, theirs) triple, in order.
+
+        Every thread opens its own handle on the repository, and the merges
+        run with the GIL released.
+
+        threads
+            The number of threads, by default the number of CPUs.
+        """
+        file_favor = self._merge_options(favor).file_favor
+        triples = [self._object_ids(triple) for triple in triples]
+
+        def merge_batch(batch):
+            repo = getattr(pool._local, 'pyrepo', None)
+            if repo is None:
+                repo = Repository._from_c(pool._crepo(), False)
+                pool._local.pyrepo = repo
+            # The handle is this thread's own, the GIL can be released
+            return [repo._merge_check(ancestor, ours, theirs, file_favor, True)
+                    for ancestor, ours, theirs in batch]
+
+        with _RepositoryPool(self, threads) as pool:
+            return pool._map_batches(merge_batch, triples)
+
+    def replay_commits(self, commits, onto, committer=None, favor='normal',
+                       update_ref=None, validate=True):
+        """
+        Replay the changes of the given commits, oldest first, on top of
+        onto, entirely in memory: the working directory, the index and
+        HEAD are left alone.
+
+        Every commit is cherry-picked against its first parent onto the
+        previous new commit, keeping its author, message and encoding. The
+        replay stops on the first commit that does not merge cleanly.
+
+        Returns: a ReplayResult (commits, tree, stopped_at, conflicts) with
+        the ids of the new commits, the id of the last tree, and, if the
+        replay stopped, the id of the commit which conflicted and the
+        conflicting paths (otherwise None and []).
+
+        Parameters:
+
+        committer
+            The committer of the new commits, by default the committer of
+            every original commit.
+
+        favor
+            Like in merge_trees().
+
+        update_ref
+            A reference to point to the last new commit, only updated when
+            every commit was replayed.
+
+        validate
+            Like in create_commit_from_ids().
+        """
+        file_favor = self._merge_options(favor).file_favor
+        onto, = self._object_ids([onto])
+        result = self._replay_commits(self._object_ids(commits), onto,
+                                      committer, file_favor, update_ref,
+                                      validate)
+        return ReplayResult(*result)
+
+    def rebase_commits(self, upstream, head, onto=None, **kwargs):
+        """
+        Replay the commits reachable from head but not from upstream onto
+        onto, by default upstream, like "git rebase --onto onto upstream
+        head" does without touching the working directory. Merge commits
+        are skipped.
+
+        The other parameters and the return value are those of
+        replay_commits().
+        """
+        upstream, head = self._object_ids([upstream, head])
+        walker = self.walk(head, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE)
+        walker.hide(upstream)
+        commits = [commit.id for commit in walker
+                   if len(commit.parent_ids) < 2]
+        if onto is None:
+            onto = upstream
+        return self.replay_commits(commits, onto, **kwargs)
+
     #
     # Describe
     #
@@ -788,6 +1316,35 @@ class BaseRepository(_Repository):
             repo.describe(pattern='public/*', dirty_suffix='-dirty')
         """
 
+        options, pattern_char = self._describe_options(
+            max_candidates_tags, describe_strategy, pattern,
+            only_follow_first_parent, show_commit_oid_as_fallback)
+        format_options, dirty_ptr = self._describe_format_options(
+            abbreviated_size, always_use_long_format, dirty_suffix)
+
+        result = ffi.new('git_describe_result **')
+        if committish:
+            if isinstance(committish, str):
+                committish = self.revparse_single(committish)
+
+            commit = committish.peel(Commit)
+
+            cptr = ffi.new('git_object **')
+            ffi.buffer(cptr)[:] = commit._pointer[:]
+
+            err = C.git_describe_commit(result, cptr[0], options)
+        else:
+            err = C.git_describe_workdir(result, self._repo, options)
+        check_error(err)
+
+        return self._describe_format(result[0], format_options)
+
+    @staticmethod
+    def _describe_options(max_candidates_tags, describe_strategy, pattern,
+                          only_follow_first_parent,
+                          show_commit_oid_as_fallback):
+        """Return a 'git_describe_options *' and the strings it points to,
+        which must be kept alive as long as the options are used."""
         options = ffi.new('git_describe_options *')
         C.git_describe_init_options(options, C.GIT_DESCRIBE_OPTIONS_VERSION)
 
@@ -795,10 +1352,8 @@ class BaseRepository(_Repository):
             options.max_candidates_tags = max_candidates_tags
         if describe_strategy is not None:
             options.describe_strategy = describe_strategy
+        pattern_char = None
         if pattern:
-            # The returned pointer object has ownership on the allocated
-            # memory. Make sure it is kept alive until git_describe_commit() or
-            # git_describe_workdir() are called below.
             pattern_char = ffi.new('char[]', to_bytes(pattern))
             options.pattern = pattern_char
         if only_follow_first_parent is not None:
@@ -806,37 +1361,36 @@ class BaseRepository(_Repository):
         if show_commit_oid_as_fallback is not None:
             options.show_commit_oid_as_fallback = show_commit_oid_as_fallback
 
-        result = ffi.new('git_describe_result **')
-        if committish:
-            if isinstance(committish, str):
-                committish = self.revparse_single(committish)
-
-            commit = committish.peel(Commit)
+        return options, pattern_char
 
-            cptr = ffi.new('git_object **')
-            ffi.buffer(cptr)[:] = commit._pointer[:]
-
-            err = C.git_describe_commit(result, cptr[0], options)
-        else:
-            err = C.git_describe_workdir(result, self._repo, options)
-        check_error(err)
+    @staticmethod
+    def _describe_format_options(abbreviated_size, always_use_long_format,
+                                 dirty_suffix):
+        """Return a 'git_describe_format_options *' and the strings it
+        points to, which must be kept alive as long as the options are
+        used."""
+        format_options = ffi.new('git_describe_format_options *')
+        C.git_describe_init_format_options(
+            format_options, C.GIT_DESCRIBE_FORMAT_OPTIONS_VERSION)
+
+        if abbreviated_size is not None:
+            format_options.abbreviated_size = abbreviated_size
+        if always_use_long_format is not None:
+            format_options.always_use_long_format = always_use_long_format
+        dirty_ptr = None
+        if dirty_suffix:
+            dirty_ptr = ffi.new('char[]', to_bytes(dirty_suffix))
+            format_options.dirty_suffix = dirty_ptr
+
+        return format_options, dirty_ptr
 
+    @staticmethod
+    def _describe_format(cresult, format_options):
+        """Format and free a 'git_describe_result *'"""
         try:
-            format_options = ffi.new('git_describe_format_options *')
-            C.git_describe_init_format_options(format_options, C.GIT_DESCRIBE_FORMAT_OPTIONS_VERSION)
-
-            if abbreviated_size is not None:
-                format_options.abbreviated_size = abbreviated_size
-            if always_use_long_format is not None:
-                format_options.always_use_long_format = always_use_long_format
-            dirty_ptr = None
-            if dirty_suffix:
-                dirty_ptr = ffi.new('char[]', to_bytes(dirty_suffix))
-                format_options.dirty_suffix = dirty_ptr
-
             buf = ffi.new('git_buf *', (ffi.NULL, 0))
 
-            err = C.git_describe_format(buf, result[0], format_options)
+            err = C.git_describe_format(buf, cresult, format_options)
             check_error(err)
 
             try:
@@ -844,7 +1398,84 @@ class BaseRepository(_Repository):
             finally:
                 C.git_buf_dispose(buf)
         finally:
-            C.git_describe_result_free(result[0])
+            C.git_describe_result_free(cresult)
+
+    def describe_many(self, commits, threads=None, **kwargs):
+        """
+        Describe many commits on a pool of threads, and return their
+        descriptions in order, with None for the commits which cannot be
+        described.
+
+        The options are parsed once for all the commits, and every thread
+        opens its own handle on the repository and describes a batch of
+        commits at a time, so its references and the tag and commit objects
+        loaded for one commit stay cached for the next ones. A commit listed
+        more than once is only described once.
+
+        Parameters:
+
+        commits
+            The commit-ish objects or object names to describe.
+
+        threads
+            The number of threads, by default the number of CPUs.
+
+        The other parameters are those of describe(), but dirty_suffix.
+
+        Example::
+
+            repo.describe_many(repo.walk(repo.head.target), pattern='v*')
+        """
+        options, pattern_char = self._describe_options(
+            kwargs.pop('max_candidates_tags', None),
+            kwargs.pop('describe_strategy', None),
+            kwargs.pop('pattern', None),
+            kwargs.pop('only_follow_first_parent', None),
+            kwargs.pop('show_commit_oid_as_fallback', None))
+        format_options, _ = self._describe_format_options(
+            kwargs.pop('abbreviated_size', None),
+            kwargs.pop('always_use_long_format', None),
+            None)
+        if kwargs:
+            raise TypeError('unexpected keyword argument %r' % next(iter(kwargs)))
+
+        ids = []
+        for committish in commits:
+            if isinstance(committish, str):
+                committish = self.revparse_single(committish)
+            elif isinstance(committish, Oid):
+                committish = self[committish]
+            ids.append(committish.peel(Commit).id)
+        unique = list(dict.fromkeys(ids))
+
+        def describe_batch(batch):
+            crepo = pool._crepo()
+            coid = ffi.new('git_oid *')
+            cobj = ffi.new('git_object **')
+            result = ffi.new('git_describe_result **')
+            descriptions = []
+            for oid in batch:
+                ffi.buffer(coid)[:] = oid.raw
+                err = C.git_object_lookup(cobj, crepo, coid,
+                                          C.GIT_OBJECT_COMMIT)
+                check_error(err)
+                try:
+                    err = C.git_describe_commit(result, cobj[0], options)
+                finally:
+                    C.git_object_free(cobj[0])
+                if err == C.GIT_ENOTFOUND:
+                    descriptions.append(None)
+                    continue
+                check_error(err)
+                descriptions.append(self._describe_format(result[0],
+                                                          format_options))
+            return descriptions
+
+        with _RepositoryPool(self, threads) as pool:
+            descriptions = pool._map_batches(describe_batch, unique)
+
+        descriptions = dict(zip(unique, descriptions))
+        return [descriptions[oid] for oid in ids]
 
     #
     # Stash
@@ -909,7 +1540,7 @@ class BaseRepository(_Repository):
         copts, refs = Repository._checkout_args_to_options(**kwargs)
         stash_opts.checkout_options = copts[0]
 
-        return stash_opts
+        return stash_opts, refs
 
     def stash_apply(self, index=0, **kwargs):
         """
@@ -933,8 +1564,9 @@ class BaseRepository(_Repository):
             >>> repo.stash(repo.default_signature(), 'WIP: stashing')
             >>> repo.stash_apply(strategy=GIT_CHECKOUT_ALLOW_CONFLICTS)
         """
-        stash_opts = Repository._stash_args_to_options(**kwargs)
-        check_error(C.git_stash_apply(self._repo, index, stash_opts))
+        stash_opts, refs = Repository._stash_args_to_options(**kwargs)
+        err = C.git_stash_apply(self._repo, index, stash_opts)
+        Repository._checkout_check_error(err, kwargs.get('callbacks'))
 
     def stash_drop(self, index=0):
         """
@@ -953,13 +1585,15 @@ class BaseRepository(_Repository):
 
         For arguments, see Repository.stash_apply().
         """
-        stash_opts = Repository._stash_args_to_options(**kwargs)
-        check_error(C.git_stash_pop(self._repo, index, stash_opts))
+        stash_opts, refs = Repository._stash_args_to_options(**kwargs)
+        err = C.git_stash_pop(self._repo, index, stash_opts)
+        Repository._checkout_check_error(err, kwargs.get('callbacks'))
 
     #
     # Utility for writing a tree into an archive
     #
-    def write_archive(self, treeish, archive, timestamp=None, prefix=''):
+    def write_archive(self, treeish, archive, timestamp=None, prefix='',
+                      format=None, compresslevel=-1, threads=1):
         """
         Write treeish into an archive.
 
@@ -975,7 +1609,11 @@ class BaseRepository(_Repository):
             The treeish to write.
 
         archive
-            An archive from the 'tarfile' module.
+            An archive from the 'tarfile' module (any object with an
+            'addfile' method), or a writable binary file object or file
+            descriptor to write an archive of the given format to. The latter is done natively: the tree is walked and the
+            archive written in chunks, without going through Python objects
+            for the files.
 
         timestamp
             Timestamp to use for the files in the archive.
@@ -983,12 +1621,29 @@ class BaseRepository(_Repository):
         prefix
             Extra prefix to add to the path names in the archive.
 
+        format
+            The format of the archive written to a file object or
+            descriptor: 'tar' (default), 'tar.gz' (or 'tgz') or 'zip'.
+
+        compresslevel
+            The zlib compression level for 'tar.gz' and 'zip', from 0 to 9,
+            by default zlib's.
+
+        threads
+            The number of threads to compress a 'tar.gz' archive on, None
+            for the number of CPUs. With more than one, the archive is cut
+            into blocks compressed in parallel, like pigz does; the output
+            is still a single standard gzip stream.
+
         Example::
 
             >>> import tarfile, pygit2
             >>>> with tarfile.open('foo.tar', 'w') as archive:
             >>>>     repo = pygit2.Repository('.')
             >>>>     repo.write_archive(repo.head.target, archive)
+
+            >>>> with open('foo.zip', 'wb') as f:
+            >>>>     repo.write_archive(repo.head.target, f, format='zip')
         """
 
         # Try to get a tree form whatever we got
@@ -1012,6 +1667,26 @@ class BaseRepository(_Repository):
 
         tree = treeish.peel(Tree)
 
+        if not hasattr(archive, 'addfile'):
+            kind = _ARCHIVE_FORMATS.get(format or 'tar')
+            if kind is None:
+                raise ValueError("unknown archive format %s" % format)
+
+            if isinstance(archive, int):
+                with open(archive, 'wb', closefd=False) as f:
+                    self.write_archive(tree, f, timestamp, prefix, format,
+                                       compresslevel, threads)
+            elif kind == _ARCHIVE_TAR_GZ and threads != 1:
+                # Write a plain tar, compressed on the side
+                with _ParallelGzipWriter(archive, compresslevel, threads,
+                                         int(timestamp)) as gz:
+                    self._write_archive(tree.id, gz, _ARCHIVE_TAR, prefix,
+                                        int(timestamp), compresslevel)
+            else:
+                self._write_archive(tree.id, archive, kind, prefix,
+                                    int(timestamp), compresslevel)
+            return
+
         index = Index()
         index.read_tree(tree)
 
@@ -1097,8 +1772,13 @@ class BaseRepository(_Repository):
         err = C.git_attr_get(cvalue, self._repo, flags, to_bytes(path), to_bytes(name))
         check_error(err)
 
-        # Now let's see if we can figure out what the value is
-        attr_kind = C.git_attr_value(cvalue[0])
+        return self._attr_value(cvalue[0])
+
+    @staticmethod
+    def _attr_value(cvalue, strings=None):
+        """Convert an attribute value from libgit2. Values are looked up in
+        the strings dict, if given, so equal values share one object."""
+        attr_kind = C.git_attr_value(cvalue)
         if attr_kind == C.GIT_ATTR_UNSPECIFIED_T:
             return None
         elif attr_kind == C.GIT_ATTR_TRUE_T:
@@ -1106,10 +1786,72 @@ class BaseRepository(_Repository):
         elif attr_kind == C.GIT_ATTR_FALSE_T:
             return False
         elif attr_kind == C.GIT_ATTR_VALUE_T:
-            return ffi.string(cvalue[0]).decode('utf-8')
+            value = ffi.string(cvalue)
+            if strings is None:
+                return value.decode('utf-8')
+            string = strings.get(value)
+            if string is None:
+                string = strings[value] = value.decode('utf-8')
+            return string
 
         assert False, "the attribute value from libgit2 is invalid"
 
+    def get_attrs_many(self, paths, names, flags=0, threads=None):
+        """
+        Retrieve many attributes for many files at once.
+
+        Returns: a list with, for every path, a tuple of the values of the
+        attributes in the order of names, as returned by get_attr(). Equal
+        string values share one object.
+
+        Every path is looked up with a single git_attr_get_many call. The
+        paths are split between a pool of threads, each with its own
+        handle on the repository, and so its own cache of the parsed
+        attribute files, which are then only re-read when they change.
+
+        Parameters:
+
+        paths
+            The paths of the files to look up attributes for, relative to
+            the workdir root.
+
+        names
+            The names of the attributes to look up.
+
+        flags
+            Like in get_attr().
+
+        threads
+            The number of threads, by default the number of CPUs.
+
+        Example::
+
+            >>> repo.get_attrs_many(['a.py', 'b.bin'], ['text', 'filter'])
+            [(True, None), (False, 'lfs')]
+        """
+        paths = [to_bytes(path) for path in paths]
+        cnames = [ffi.new('char[]', to_bytes(name)) for name in names]
+        if not cnames:
+            return [() for path in paths]
+        cnames_ptr = ffi.new('char *[]', cnames)
+        num_attr = len(cnames)
+
+        def attrs_batch(batch):
+            crepo = pool._crepo()
+            cvalues = ffi.new('char *[]', num_attr)
+            strings = {}
+            rows = []
+            for path in batch:
+                err = C.git_attr_get_many(cvalues, crepo, flags, path,
+                                          num_attr, cnames_ptr)
+                check_error(err)
+                rows.append(tuple(self._attr_value(cvalue, strings)
+                                  for cvalue in cvalues))
+            return rows
+
+        with _RepositoryPool(self, threads) as pool:
+            return pool._map_batches(attrs_batch, paths)
+
     #
     # Identity for reference operations
     #
@@ -0,0 +1,800 @@
+/*
+ * Copyright 2010-2020 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "archive.h"
+
+/*
+ * Archives are written to a Python writable in chunks of ARCHIVE_CHUNK
+ * bytes, going through a zlib compressor for tar.gz. Blobs are written
+ * straight from the memory libgit2 inflated them to, without a Python
+ * copy, and freed right after.
+ */
+
+#define ARCHIVE_CHUNK (64 * 1024)
+#define ARCHIVE_DEFLATE_CHUNK (1024 * 1024)
+
+#define TAR_BLOCK 512
+#define TAR_MAX_SIZE 077777777777ULL
+
+#define ZIP_MAX_32 0xffffffffULL
+#define ZIP_MAX_16 0xffff
+/* Deflate may grow incompressible data a little, up to 0.03% */
+#define ZIP_MAX_UNCOMPRESSED_32 0xff000000ULL
+
+typedef struct {
+    uint64_t offset;
+    uint64_t usize;
+    uint64_t csize;
+    uint32_t crc;
+    uint32_t mode;
+    size_t name;       /* offset in names */
+    size_t name_len;
+    uint16_t method;
+    int zip64;
+} pgit_zip_entry;
+
+typedef struct {
+    git_repository *repo;
+    int format;
+    int level;
+    git_time_t mtime;
+    const char *prefix;
+    size_t prefix_len;
+
+    /* Output */
+    PyObject *write;
+    PyObject *compressor;
+    char *buf;
+    size_t len;
+    uint64_t offset;
+
+    /* Scratch path */
+    char *path;
+    size_t path_alloc;
+
+    /* Zip central directory */
+    PyObject *zlib;
+    pgit_zip_entry *entries;
+    size_t count, alloc;
+    char *names;
+    size_t names_len, names_alloc;
+} pgit_archive;
+
+static int
+archive_grow(void **ptr, size_t *alloc, size_t needed, size_t size)
+{
+    size_t n = *alloc ? *alloc : 64;
+    void *p;
+
+    if (needed <= *alloc)
+        return 0;
+
+    while (n < needed)
+        n *= 2;
+    p = PyMem_Realloc(*ptr, n * size);
+    if (p == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    *ptr = p;
+    *alloc = n;
+    return 0;
+}
+
+/*
+ * Output
+ */
+
+/*
+ * Write all of data. Raw files may write less than asked and return the
+ * count, buffered ones write everything and return it or None.
+ */
+static int
+archive_output(pgit_archive *a, PyObject *data)
+{
+    PyObject *result, *view;
+    Py_ssize_t len = PyBytes_GET_SIZE(data), pos = 0, n;
+
+    if (len == 0)
+        return 0;
+
+    result = PyObject_CallFunctionObjArgs(a->write, data, NULL);
+    for (;;) {
+        if (result == NULL)
+            return -1;
+        if (!PyLong_Check(result)) {
+            Py_DECREF(result);
+            return 0;
+        }
+
+        n = PyLong_AsSsize_t(result);
+        Py_DECREF(result);
+        if (n == -1 && PyErr_Occurred())
+            return -1;
+        if (n <= 0) {
+            PyErr_SetString(PyExc_OSError, "write() did not write any data");
+            return -1;
+        }
+
+        pos += n;
+        if (pos >= len)
+            return 0;
+
+        view = PyMemoryView_FromMemory(PyBytes_AS_STRING(data) + pos,
+                                       len - pos, PyBUF_READ);
+        if (view == NULL)
+            return -1;
+        result = PyObject_CallFunctionObjArgs(a->write, view, NULL);
+        Py_DECREF(view);
+    }
+}
+
+static int
+archive_flush(pgit_archive *a)
+{
+    PyObject *data;
+    int err;
+
+    if (a->len == 0)
+        return 0;
+
+    if (a->compressor)
+        data = PyObject_CallMethod(a->compressor, "compress", "y#",
+                                   a->buf, (Py_ssize_t)a->len);
+    else
+        data = PyBytes_FromStringAndSize(a->buf, a->len);
+    if (data == NULL)
+        return -1;
+
+    err = archive_output(a, data);
+    Py_DECREF(data);
+    a->len = 0;
+    return err;
+}
+
+static int
+archive_write(pgit_archive *a, const void *data, size_t len)
+{
+    const char *p = data;
+    size_t n;
+
+    a->offset += len;
+    while (len > 0) {
+        n = ARCHIVE_CHUNK - a->len;
+        if (n > len)
+            n = len;
+        if (p)
+            memcpy(a->buf + a->len, p, n);
+        else
+            memset(a->buf + a->len, 0, n);
+        a->len += n;
+        len -= n;
+        if (p)
+            p += n;
+
+        if (a->len == ARCHIVE_CHUNK && archive_flush(a) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+#define archive_zeros(a, len) archive_write(a, NULL, len)
+
+static int
+archive_finish(pgit_archive *a)
+{
+    PyObject *data;
+    int err;
+
+    if (archive_flush(a) < 0)
+        return -1;
+
+    if (a->compressor == NULL)
+        return 0;
+
+    data = PyObject_CallMethod(a->compressor, "flush", NULL);
+    if (data == NULL)
+        return -1;
+
+    err = archive_output(a, data);
+    Py_DECREF(data);
+    return err;
+}
+
+/*
+ * Tar
+ */
+
+static void
+tar_octal(char *field, size_t size, uint64_t value)
+{
+    /* size counts the trailing NUL */
+    PyOS_snprintf(field, size, "%0*llo", (int)(size - 1),
+                  (unsigned long long)value);
+}
+
+static int
+tar_pax_record(char **buf, size_t *len, size_t *alloc, const char *key,
+               const char *value, size_t value_len)
+{
+    size_t n, total, digits;
+    char number[24];
+
+    /* The length of the record counts its own digits */
+    n = strlen(key) + value_len + 3;
+    digits = PyOS_snprintf(number, sizeof(number), "%zu", n);
+    total = n + digits;
+    if ((size_t)PyOS_snprintf(number, sizeof(number), "%zu", total) != digits)
+        total++;
+
+    if (archive_grow((void **)buf, alloc, *len + total + 1, 1) < 0)
+        return -1;
+
+    PyOS_snprintf(*buf + *len, total + 1, "%zu %s=", total, key);
+    memcpy(*buf + *len + total - value_len - 1, value, value_len);
+    (*buf)[*len + total - 1] = '\n';
+    *len += total;
+    return 0;
+}
+
+static int
+tar_block(pgit_archive *a, const char *name, size_t name_len,
+          const char *prefix, size_t prefix_len, const char *link,
+          size_t link_len, unsigned int mode, char type, uint64_t size)
+{
+    char header[TAR_BLOCK];
+    unsigned int checksum = 0;
+    size_t i;
+
+    memset(header, 0, TAR_BLOCK);
+    memcpy(header, name, name_len);
+    tar_octal(header + 100, 8, mode);
+    tar_octal(header + 108, 8, 0);
+    tar_octal(header + 116, 8, 0);
+    tar_octal(header + 124, 12, size);
+    tar_octal(header + 136, 12, a->mtime < 0 ? 0 : (uint64_t)a->mtime);
+    header[156] = type;
+    memcpy(header + 157, link, link_len);
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    memcpy(header + 265, "root", 4);
+    memcpy(header + 297, "root", 4);
+    memcpy(header + 345, prefix, prefix_len);
+
+    memset(header + 148, ' ', 8);
+    for (i = 0; i < TAR_BLOCK; i++)
+        checksum += (unsigned char)header[i];
+    PyOS_snprintf(header + 148, 7, "%06o", checksum);
+
+    return archive_write(a, header, TAR_BLOCK);
+}
+
+static int
+tar_pad(pgit_archive *a, uint64_t size)
+{
+    size_t rest = size % TAR_BLOCK;
+
+    return rest ? archive_zeros(a, TAR_BLOCK - rest) : 0;
+}
+
+static int
+tar_entry(pgit_archive *a, const char *path, size_t path_len,
+          unsigned int mode, const char *data, size_t size)
+{
+    const char *link = "";
+    size_t link_len = 0, prefix_len = 0, split;
+    char *pax = NULL;
+    size_t pax_len = 0, pax_alloc = 0;
+    char type = '0';
+    char number[24];
+    int err = -1;
+
+    if (mode == GIT_FILEMODE_LINK) {
+        type = '2';
+        link = data;
+        link_len = size;
+        data = NULL;
+        size = 0;
+        mode = 0777;
+    } else {
+        mode &= 07777;
+    }
+
+    /* Split long paths between the name and the prefix fields... */
+    if (path_len > 100) {
+        for (split = path_len - 1; split > 0; split--) {
+            if (path[split] == '/' && split <= 155 &&
+                path_len - split - 1 <= 100) {
+                prefix_len = split;
+                break;
+            }
+        }
+    }
+
+    /* ...or record them in a pax header, like sizes over 8 GiB */
+    if (path_len > 100 && prefix_len == 0 &&
+        tar_pax_record(&pax, &pax_len, &pax_alloc, "path", path, path_len) < 0)
+        goto out;
+    if (link_len > 100 &&
+        tar_pax_record(&pax, &pax_len, &pax_alloc, "linkpath", link,
+                       link_len) < 0)
+        goto out;
+    if (size > TAR_MAX_SIZE) {
+        PyOS_snprintf(number, sizeof(number), "%zu", size);
+        if (tar_pax_record(&pax, &pax_len, &pax_alloc, "size", number,
+                           strlen(number)) < 0)
+            goto out;
+    }
+
+    if (pax) {
+        if (tar_block(a, "././@PaxHeader", 14, "", 0, "", 0, 0644, 'x',
+                      pax_len) < 0 ||
+            archive_write(a, pax, pax_len) < 0 ||
+            tar_pad(a, pax_len) < 0)
+            goto out;
+    }
+
+    if (prefix_len)
+        err = tar_block(a, path + prefix_len + 1, path_len - prefix_len - 1,
+                        path, prefix_len, link, link_len > 100 ? 100 : link_len,
+                        mode, type, size > TAR_MAX_SIZE ? 0 : size);
+    else
+        err = tar_block(a, path, path_len > 100 ? 100 : path_len, "", 0,
+                        link, link_len > 100 ? 100 : link_len, mode, type,
+                        size > TAR_MAX_SIZE ? 0 : size);
+    if (err == 0 && size > 0) {
+        err = archive_write(a, data, size);
+        if (err == 0)
+            err = tar_pad(a, size);
+    }
+
+out:
+    PyMem_Free(pax);
+    return err;
+}
+
+static int
+tar_end(pgit_archive *a)
+{
+    return archive_zeros(a, 2 * TAR_BLOCK);
+}
+
+/*
+ * Zip
+ */
+
+static char *
+put16(char *p, unsigned int value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    return p + 2;
+}
+
+static char *
+put32(char *p, uint32_t value)
+{
+    p = put16(p, value & 0xffff);
+    return put16(p, value >> 16);
+}
+
+static char *
+put64(char *p, uint64_t value)
+{
+    p = put32(p, (uint32_t)(value & 0xffffffff));
+    return put32(p, (uint32_t)(value >> 32));
+}
+
+/* MS-DOS time and date, in UTC */
+static void
+zip_dos_time(git_time_t mtime, unsigned int *time, unsigned int *date)
+{
+    long long days, secs, era, doe, yoe, doy, mp;
+    long long year, month, day;
+
+    if (mtime < 315532800)   /* 1980-01-01, the first MS-DOS date */
+        mtime = 315532800;
+
+    days = mtime / 86400;
+    secs = mtime % 86400;
+
+    /* Civil date from days since the epoch */
+    days += 719468;
+    era = days / 146097;
+    doe = days - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = yoe + era * 400 + (month <= 2);
+    if (year > 2107)
+        year = 2107;
+
+    *time = (unsigned int)((secs / 3600) << 11 | ((secs / 60) % 60) << 5 |
+                           (secs % 60) / 2);
+    *date = (unsigned int)((year - 1980) << 9 | month << 5 | day);
+}
+
+static int
+zip_crc32(pgit_archive *a, const char *data, size_t size, uint32_t *crc)
+{
+    PyObject *view, *result;
+
+    view = PyMemoryView_FromMemory((char *)data, size, PyBUF_READ);
+    if (view == NULL)
+        return -1;
+
+    result = PyObject_CallMethod(a->zlib, "crc32", "Ok", view,
+                                 (unsigned long)*crc);
+    Py_DECREF(view);
+    if (result == NULL)
+        return -1;
+
+    *crc = (uint32_t)PyLong_AsUnsignedLong(result);
+    Py_DECREF(result);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static int
+zip_output(pgit_archive *a, PyObject *data, uint64_t *csize)
+{
+    *csize += PyBytes_GET_SIZE(data);
+    return archive_write(a, PyBytes_AS_STRING(data), PyBytes_GET_SIZE(data));
+}
+
+static int
+zip_deflate(pgit_archive *a, const char *data, size_t size, uint64_t *csize)
+{
+    PyObject *compressor, *view, *out;
+    size_t n;
+    int err = -1;
+
+    /* Raw deflate, the zip headers take the place of zlib's */
+    compressor = PyObject_CallMethod(a->zlib, "compressobj", "iii", a->level,
+                                     8, -15);
+    if (compressor == NULL)
+        return -1;
+
+    for (; size > 0; data += n, size -= n) {
+        n = size < ARCHIVE_DEFLATE_CHUNK ? size : ARCHIVE_DEFLATE_CHUNK;
+        view = PyMemoryView_FromMemory((char *)data, n, PyBUF_READ);
+        if (view == NULL)
+            goto out;
+        out = PyObject_CallMethod(compressor, "compress", "O", view);
+        Py_DECREF(view);
+        if (out == NULL)
+            goto out;
+        err = zip_output(a, out, csize);
+        Py_DECREF(out);
+        if (err < 0)
+            goto out;
+        err = -1;
+    }
+
+    out = PyObject_CallMethod(compressor, "flush", NULL);
+    if (out == NULL)
+        goto out;
+    err = zip_output(a, out, csize);
+    Py_DECREF(out);
+
+out:
+    Py_DECREF(compressor);
+    return err;
+}
+
+static int
+zip_entry(pgit_archive *a, const char *path, size_t path_len,
+          unsigned int mode, const char *data, size_t size)
+{
+    pgit_zip_entry *entry;
+    char header[30 + 20], *p;
+    unsigned int time, date;
+    int zip64;
+
+    if (path_len > ZIP_MAX_16) {
+        PyErr_Format(PyExc_ValueError, "path too long for zip: %.100s...",
+                     path);
+        return -1;
+    }
+
+    if (archive_grow((void **)&a->entries, &a->alloc, a->count + 1,
+                     sizeof(pgit_zip_entry)) < 0 ||
+        archive_grow((void **)&a->names, &a->names_alloc,
+                     a->names_len + path_len, 1) < 0)
+        return -1;
+
+    entry = &a->entries[a->count];
+    entry->offset = a->offset;
+    entry->usize = size;
+    entry->csize = 0;
+    entry->crc = 0;
+    entry->mode = mode == GIT_FILEMODE_LINK ? 0120777 : mode;
+    entry->name = a->names_len;
+    entry->name_len = path_len;
+    entry->method = (a->level == 0 || size == 0 ||
+                     mode == GIT_FILEMODE_LINK) ? 0 : 8;
+    entry->zip64 = zip64 = size > ZIP_MAX_UNCOMPRESSED_32;
+    memcpy(a->names + a->names_len, path, path_len);
+
+    /* Sizes and crc follow the data, in a data descriptor */
+    zip_dos_time(a->mtime, &time, &date);
+    p = put32(header, 0x04034b50);
+    p = put16(p, zip64 ? 45 : 20);
+    p = put16(p, 0x0808);          /* data descriptor, utf-8 names */
+    p = put16(p, entry->method);
+    p = put16(p, time);
+    p = put16(p, date);
+    p = put32(p, 0);
+    p = put32(p, zip64 ? 0xffffffff : 0);
+    p = put32(p, zip64 ? 0xffffffff : 0);
+    p = put16(p, path_len);
+    p = put16(p, zip64 ? 20 : 0);
+    if (zip64) {
+        p = put16(p, 0x0001);
+        p = put16(p, 16);
+        p = put64(p, 0);
+        p = put64(p, 0);
+    }
+    if (archive_write(a, header, p - header) < 0 ||
+        archive_write(a, path, path_len) < 0)
+        return -1;
+
+    if (size > 0 && zip_crc32(a, data, size, &entry->crc) < 0)
+        return -1;
+    if (entry->method == 8) {
+        if (zip_deflate(a, data, size, &entry->csize) < 0)
+            return -1;
+    } else {
+        entry->csize = size;
+        if (archive_write(a, data, size) < 0)
+            return -1;
+    }
+
+    p = put32(header, 0x08074b50);
+    p = put32(p, entry->crc);
+    if (zip64) {
+        p = put64(p, entry->csize);
+        p = put64(p, entry->usize);
+    } else {
+        p = put32(p, (uint32_t)entry->csize);
+        p = put32(p, (uint32_t)entry->usize);
+    }
+    if (archive_write(a, header, p - header) < 0)
+        return -1;
+
+    a->names_len += path_len;
+    a->count++;
+    return 0;
+}
+
+static int
+zip_end(pgit_archive *a)
+{
+    pgit_zip_entry *entry;
+    uint64_t cd_offset = a->offset, cd_size, eocd64_offset;
+    char header[46 + 28], *p, *extra;
+    unsigned int time, date;
+    size_t i, extra_len;
+    int zip64;
+
+    zip_dos_time(a->mtime, &time, &date);
+    for (i = 0; i < a->count; i++) {
+        entry = &a->entries[i];
+
+        /* Sizes and offsets which do not fit go to the zip64 field */
+        extra = header + 46;
+        p = extra + 4;
+        if (entry->zip64) {
+            p = put64(p, entry->usize);
+            p = put64(p, entry->csize);
+        }
+        if (entry->offset >= ZIP_MAX_32)
+            p = put64(p, entry->offset);
+        extra_len = p - extra;
+        put16(put16(extra, 0x0001), (unsigned int)(extra_len - 4));
+        zip64 = extra_len > 4;
+
+        p = put32(header, 0x02014b50);
+        p = put16(p, 3 << 8 | (zip64 ? 45 : 20));   /* made by unix */
+        p = put16(p, zip64 ? 45 : 20);
+        p = put16(p, 0x0808);
+        p = put16(p, entry->method);
+        p = put16(p, time);
+        p = put16(p, date);
+        p = put32(p, entry->crc);
+        p = put32(p, entry->zip64 ? 0xffffffff : (uint32_t)entry->csize);
+        p = put32(p, entry->zip64 ? 0xffffffff : (uint32_t)entry->usize);
+        p = put16(p, entry->name_len);
+        p = put16(p, zip64 ? (unsigned int)extra_len : 0);
+        p = put16(p, 0);                            /* comment */
+        p = put16(p, 0);                            /* disk */
+        p = put16(p, 0);                            /* internal attributes */
+        p = put32(p, entry->mode << 16);
+        p = put32(p, entry->offset >= ZIP_MAX_32 ? 0xffffffff :
+                     (uint32_t)entry->offset);
+
+        if (archive_write(a, header, 46) < 0 ||
+            archive_write(a, a->names + entry->name, entry->name_len) < 0)
+            return -1;
+        if (zip64 && archive_write(a, extra, extra_len) < 0)
+            return -1;
+    }
+    cd_size = a->offset - cd_offset;
+
+    zip64 = a->count >= ZIP_MAX_16 || cd_size >= ZIP_MAX_32 ||
+            cd_offset >= ZIP_MAX_32;
+    if (zip64) {
+        eocd64_offset = a->offset;
+        p = put32(header, 0x06064b50);
+        p = put64(p, 44);
+        p = put16(p, 3 << 8 | 45);
+        p = put16(p, 45);
+        p = put32(p, 0);
+        p = put32(p, 0);
+        p = put64(p, a->count);
+        p = put64(p, a->count);
+        p = put64(p, cd_size);
+        p = put64(p, cd_offset);
+        if (archive_write(a, header, p - header) < 0)
+            return -1;
+
+        p = put32(header, 0x07064b50);
+        p = put32(p, 0);
+        p = put64(p, eocd64_offset);
+        p = put32(p, 1);
+        if (archive_write(a, header, p - header) < 0)
+            return -1;
+    }
+
+    p = put32(header, 0x06054b50);
+    p = put16(p, 0);
+    p = put16(p, 0);
+    p = put16(p, zip64 ? ZIP_MAX_16 : (unsigned int)a->count);
+    p = put16(p, zip64 ? ZIP_MAX_16 : (unsigned int)a->count);
+    p = put32(p, zip64 ? 0xffffffff : (uint32_t)cd_size);
+    p = put32(p, zip64 ? 0xffffffff : (uint32_t)cd_offset);
+    p = put16(p, 0);
+    return archive_write(a, header, p - header);
+}
+
+/*
+ * Tree walk
+ */
+
+static int
+archive_walk_cb(const char *root, const git_tree_entry *entry, void *payload)
+{
+    pgit_archive *a = payload;
+    git_filemode_t mode = git_tree_entry_filemode(entry);
+    const char *name = git_tree_entry_name(entry);
+    size_t root_len = strlen(root), name_len = strlen(name), path_len;
+    git_blob *blob;
+    const char *data;
+    size_t size;
+    int err;
+
+    /* Like write_archive always did, only files and symlinks */
+    if (mode != GIT_FILEMODE_BLOB && mode != GIT_FILEMODE_BLOB_EXECUTABLE &&
+        mode != GIT_FILEMODE_LINK)
+        return 0;
+
+    path_len = a->prefix_len + root_len + name_len;
+    if (archive_grow((void **)&a->path, &a->path_alloc, path_len + 1, 1) < 0)
+        return GIT_EUSER;
+    memcpy(a->path, a->prefix, a->prefix_len);
+    memcpy(a->path + a->prefix_len, root, root_len);
+    memcpy(a->path + a->prefix_len + root_len, name, name_len + 1);
+
+    err = git_blob_lookup(&blob, a->repo, git_tree_entry_id(entry));
+    if (err < 0) {
+        Error_set(err);
+        return GIT_EUSER;
+    }
+
+    data = git_blob_rawcontent(blob);
+    size = (size_t)git_blob_rawsize(blob);
+    if (a->format == PGIT_ARCHIVE_ZIP)
+        err = zip_entry(a, a->path, path_len, mode, data, size);
+    else
+        err = tar_entry(a, a->path, path_len, mode, data, size);
+    git_blob_free(blob);
+
+    return err < 0 ? GIT_EUSER : 0;
+}
+
+int
+pgit_archive_write(git_repository *repo, git_tree *tree, int format,
+                   PyObject *output, const char *prefix, git_time_t mtime,
+                   int level)
+{
+    pgit_archive a;
+    int err = -1;
+
+    memset(&a, 0, sizeof(a));
+    a.repo = repo;
+    a.format = format;
+    a.level = level;
+    a.mtime = mtime;
+    a.prefix = prefix;
+    a.prefix_len = strlen(prefix);
+
+    a.write = PyObject_GetAttrString(output, "write");
+    if (a.write == NULL)
+        return -1;
+
+    a.buf = PyMem_Malloc(ARCHIVE_CHUNK);
+    if (a.buf == NULL) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    if (format != PGIT_ARCHIVE_TAR) {
+        a.zlib = PyImport_ImportModule("zlib");
+        if (a.zlib == NULL)
+            goto out;
+    }
+    if (format == PGIT_ARCHIVE_TAR_GZ) {
+        /* wbits 31 is deflate in a gzip container */
+        a.compressor = PyObject_CallMethod(a.zlib, "compressobj", "iii",
+                                           level, 8, 31);
+        if (a.compressor == NULL)
+            goto out;
+    }
+
+    err = git_tree_walk(tree, GIT_TREEWALK_PRE, archive_walk_cb, &a);
+    if (err < 0) {
+        if (err != GIT_EUSER)
+            Error_set(err);
+        err = -1;
+        goto out;
+    }
+
+    if (format == PGIT_ARCHIVE_ZIP)
+        err = zip_end(&a);
+    else
+        err = tar_end(&a);
+    if (err == 0)
+        err = archive_finish(&a);
+
+out:
+    Py_XDECREF(a.write);
+    Py_XDECREF(a.compressor);
+    Py_XDECREF(a.zlib);
+    PyMem_Free(a.buf);
+    PyMem_Free(a.path);
+    PyMem_Free(a.entries);
+    PyMem_Free(a.names);
+    return err;
+}
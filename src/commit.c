@@ -27,6 +27,7 @@
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <string.h>
 #include "error.h"
 #include "utils.h"
 #include "signature.h"
@@ -274,6 +275,171 @@ PyGetSetDef Commit_getseters[] = {
 };
 
 
+/*
+ * Write "<header><name> <<email>> <time> <offset>\n" as libgit2 does, return
+ * the length, like snprintf.
+ */
+static int
+commit_format_signature(char *out, size_t size, const char *header,
+                        const git_signature *sig)
+{
+    int offset = sig->when.offset;
+    char sign = (offset < 0 || sig->when.sign == '-') ? '-' : '+';
+
+    if (offset < 0)
+        offset = -offset;
+
+    return snprintf(out, size, "%s%s <%s> %u %c%02d%02d\n", header,
+                    sig->name, sig->email, (unsigned)sig->when.time, sign,
+                    offset / 60, offset % 60);
+}
+
+/*
+ * The reflog message libgit2 writes for a commit: "commit: " or
+ * "commit (initial): " followed by the first paragraph of the message on
+ * one line.
+ */
+static char *
+commit_reflog_message(const char *message, size_t parent_count)
+{
+    const char *prefix = parent_count ? "commit: " : "commit (initial): ";
+    char *out, *p;
+
+    while (*message == '\n')
+        message++;
+
+    out = malloc(strlen(prefix) + strlen(message) + 1);
+    if (out == NULL)
+        return NULL;
+
+    p = out + sprintf(out, "%s", prefix);
+    for (; *message; message++) {
+        if (message[0] == '\n' && (message[1] == '\n' || message[1] == '\0'))
+            break;
+        *p++ = (*message == '\n') ? ' ' : *message;
+    }
+    while (p > out && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\r'))
+        p--;
+    *p = '\0';
+    return out;
+}
+
+/*
+ * Point update_ref, or the branch it ends up at, to the new commit, after
+ * checking it points to the first parent, as git_commit_create does.
+ */
+static int
+commit_update_ref(git_repository *repo, const char *update_ref,
+                  const git_oid *id, size_t parent_count,
+                  const git_oid *parents[], const char *message)
+{
+    git_reference *ref = NULL, *resolved = NULL, *new_ref = NULL;
+    const char *name = update_ref;
+    char *log_message = NULL;
+    int err;
+
+    err = git_reference_lookup(&ref, repo, update_ref);
+    if (err == 0) {
+        err = git_reference_resolve(&resolved, ref);
+        if (err == 0) {
+            name = git_reference_name(resolved);
+            if (parent_count == 0 ||
+                !git_oid_equal(git_reference_target(resolved), parents[0])) {
+                git_error_set_str(GIT_ERROR_OBJECT, "failed to create commit: "
+                                  "current tip is not the first parent");
+                err = GIT_EMODIFIED;
+                goto out;
+            }
+        } else if (err == GIT_ENOTFOUND) {
+            /* A symbolic reference to an unborn branch, e.g. HEAD */
+            name = git_reference_symbolic_target(ref);
+        }
+    }
+    if (err < 0 && err != GIT_ENOTFOUND)
+        goto out;
+
+    log_message = commit_reflog_message(message, parent_count);
+    if (log_message == NULL) {
+        git_error_set_str(GIT_ERROR_NOMEMORY, "out of memory");
+        err = -1;
+        goto out;
+    }
+
+    err = git_reference_create(&new_ref, repo, name, id, 1, log_message);
+
+out:
+    free(log_message);
+    git_reference_free(new_ref);
+    git_reference_free(resolved);
+    git_reference_free(ref);
+    return err;
+}
+
+/*
+ * Like git_commit_create_from_ids. If validate is 0 the tree and parents
+ * are not checked to exist, whatever GIT_OPT_ENABLE_STRICT_OBJECT_CREATION
+ * says: the commit is serialised here and written straight to the object
+ * database, as flipping that global option would affect other threads.
+ */
+int
+pgit_commit_create_from_ids(git_oid *id, git_repository *repo,
+                            const char *update_ref,
+                            const git_signature *author,
+                            const git_signature *committer,
+                            const char *message_encoding,
+                            const char *message, const git_oid *tree,
+                            size_t parent_count, const git_oid *parents[],
+                            int validate)
+{
+    git_odb *odb = NULL;
+    char *buf, *p;
+    size_t size, len, i;
+    int err;
+
+    if (validate)
+        return git_commit_create_from_ids(id, repo, update_ref, author,
+                                          committer, message_encoding,
+                                          message, tree, parent_count,
+                                          parents);
+
+    len = strlen(message);
+    size = (parent_count + 1) * (GIT_OID_HEXSZ + 8) + len + 2;
+    size += commit_format_signature(NULL, 0, "author ", author);
+    size += commit_format_signature(NULL, 0, "committer ", committer);
+    if (message_encoding)
+        size += strlen(message_encoding) + 10;
+
+    buf = malloc(size);
+    if (buf == NULL) {
+        git_error_set_str(GIT_ERROR_NOMEMORY, "out of memory");
+        return -1;
+    }
+
+    p = buf + sprintf(buf, "tree %s\n", git_oid_tostr_s(tree));
+    for (i = 0; i < parent_count; i++)
+        p += sprintf(p, "parent %s\n", git_oid_tostr_s(parents[i]));
+    p += commit_format_signature(p, size - (p - buf), "author ", author);
+    p += commit_format_signature(p, size - (p - buf), "committer ", committer);
+    if (message_encoding)
+        p += sprintf(p, "encoding %s\n", message_encoding);
+    *p++ = '\n';
+    memcpy(p, message, len);
+    p += len;
+
+    err = git_repository_odb(&odb, repo);
+    if (err == 0)
+        err = git_odb_write(id, odb, buf, p - buf, GIT_OBJ_COMMIT);
+    git_odb_free(odb);
+    free(buf);
+
+    if (err == 0 && update_ref != NULL)
+        err = commit_update_ref(repo, update_ref, id, parent_count, parents,
+                                message);
+
+    return err;
+}
+
+
 PyDoc_STRVAR(Commit__doc__, "Commit objects.");
 
 PyTypeObject CommitType = {
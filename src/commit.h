@@ -40,4 +40,13 @@ PyObject* Commit_get_commit_time_offset(Commit *commit);
 PyObject* Commit_get_committer(Commit *self);
 PyObject* Commit_get_author(Commit *self);
 
+int pgit_commit_create_from_ids(git_oid *id, git_repository *repo,
+                                const char *update_ref,
+                                const git_signature *author,
+                                const git_signature *committer,
+                                const char *message_encoding,
+                                const char *message, const git_oid *tree,
+                                size_t parent_count, const git_oid *parents[],
+                                int validate);
+
 #endif
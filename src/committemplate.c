@@ -0,0 +1,229 @@
+/*
+ * Copyright 2010-2020 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "utils.h"
+#include "oid.h"
+#include "commit.h"
+#include "committemplate.h"
+#include <git2/sys/commit.h>
+
+
+void
+CommitTemplate_dealloc(CommitTemplate *self)
+{
+    Py_CLEAR(self->repo);
+    git_signature_free(self->author);
+    git_signature_free(self->committer);
+    free(self->encoding);
+    free(self->parent_ids);
+    free(self->parent_ptrs);
+    PyObject_Del(self);
+}
+
+static int
+CommitTemplate_set_time(CommitTemplate *self, PyObject *py_time,
+                        PyObject *py_offset)
+{
+    long long time;
+    long offset;
+
+    if (py_time != Py_None) {
+        time = PyLong_AsLongLong(py_time);
+        if (time == -1 && PyErr_Occurred())
+            return -1;
+        self->author->when.time = time;
+        self->committer->when.time = time;
+    }
+
+    if (py_offset != Py_None) {
+        offset = PyLong_AsLong(py_offset);
+        if (offset == -1 && PyErr_Occurred())
+            return -1;
+        self->author->when.offset = (int)offset;
+        self->author->when.sign = offset < 0 ? '-' : '+';
+        self->committer->when.offset = (int)offset;
+        self->committer->when.sign = offset < 0 ? '-' : '+';
+    }
+
+    return 0;
+}
+
+
+PyDoc_STRVAR(CommitTemplate_create__doc__,
+    "create(message, tree, parents, time=None, offset=None, update_ref=None, validate=True) -> Oid\n"
+    "\n"
+    "Create a new commit with the author, committer and encoding of the\n"
+    "template, return its oid. Like create_commit_from_ids, the tree and\n"
+    "parents are not loaded.\n"
+    "\n"
+    "Parameters:\n"
+    "\n"
+    "message\n"
+    "    Text, encoded with the template encoding, or bytes already encoded.\n"
+    "\n"
+    "parents\n"
+    "    Sequence of Oid objects or hex strings.\n"
+    "\n"
+    "time, offset\n"
+    "    If given, the time and offset of both the author and the committer\n"
+    "    for this commit and the next ones.\n"
+    "\n"
+    "validate\n"
+    "    Like in create_commit_from_ids.");
+
+PyObject *
+CommitTemplate_create(CommitTemplate *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"message", "tree", "parents", "time", "offset",
+                             "update_ref", "validate", NULL};
+    PyObject *py_message, *py_tree, *py_parents, *parents;
+    PyObject *py_time = Py_None, *py_offset = Py_None;
+    PyObject *tmessage = NULL;
+    PyObject *py_result = NULL;
+    const char *message;
+    char *update_ref = NULL;
+    int validate = 1;
+    git_oid oid, tree_id;
+    Py_ssize_t i, parent_count;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO|OOzp", kwlist,
+                                     &py_message, &py_tree, &py_parents,
+                                     &py_time, &py_offset, &update_ref,
+                                     &validate))
+        return NULL;
+
+    if (CommitTemplate_set_time(self, py_time, py_offset) < 0)
+        return NULL;
+
+    if (py_oid_to_git_oid_expand(self->repo->repo, py_tree, &tree_id) < 0)
+        return NULL;
+
+    parents = PySequence_Fast(py_parents, "parents must be a sequence");
+    if (parents == NULL)
+        return NULL;
+
+    /* The parent arrays are kept from one commit to the next */
+    parent_count = PySequence_Fast_GET_SIZE(parents);
+    if ((size_t)parent_count > self->alloc) {
+        free(self->parent_ids);
+        free(self->parent_ptrs);
+        self->alloc = parent_count;
+        self->parent_ids = malloc(self->alloc * sizeof(git_oid));
+        self->parent_ptrs = malloc(self->alloc * sizeof(git_oid*));
+        if (self->parent_ids == NULL || self->parent_ptrs == NULL) {
+            self->alloc = 0;
+            PyErr_NoMemory();
+            goto out;
+        }
+    }
+    for (i = 0; i < parent_count; i++) {
+        if (py_oid_to_git_oid_expand(self->repo->repo,
+                                     PySequence_Fast_GET_ITEM(parents, i),
+                                     &self->parent_ids[i]) < 0)
+            goto out;
+        self->parent_ptrs[i] = &self->parent_ids[i];
+    }
+
+    message = pgit_borrow_encoding(py_message, self->encoding, &tmessage);
+    if (message == NULL)
+        goto out;
+
+    err = pgit_commit_create_from_ids(&oid, self->repo->repo, update_ref,
+                                      self->author, self->committer,
+                                      self->encoding, message, &tree_id,
+                                      (size_t)parent_count, self->parent_ptrs,
+                                      validate);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = git_oid_to_python(&oid);
+
+out:
+    Py_XDECREF(tmessage);
+    Py_DECREF(parents);
+    return py_result;
+}
+
+
+PyMethodDef CommitTemplate_methods[] = {
+    METHOD(CommitTemplate, create, METH_VARARGS | METH_KEYWORDS),
+    {NULL}
+};
+
+
+PyDoc_STRVAR(CommitTemplate__doc__,
+    "CommitTemplate objects, to create many commits with the same author,\n"
+    "committer and message encoding. These are converted once, when the\n"
+    "template is made by Repository.CommitTemplate().");
+
+PyTypeObject CommitTemplateType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.CommitTemplate",                  /* tp_name           */
+    sizeof(CommitTemplate),                    /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)CommitTemplate_dealloc,        /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    0,                                         /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT,                        /* tp_flags          */
+    CommitTemplate__doc__,                     /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    0,                                         /* tp_iter           */
+    0,                                         /* tp_iternext       */
+    CommitTemplate_methods,                    /* tp_methods        */
+    0,                                         /* tp_members        */
+    0,                                         /* tp_getset         */
+    0,                                         /* tp_base           */
+    0,                                         /* tp_dict           */
+    0,                                         /* tp_descr_get      */
+    0,                                         /* tp_descr_set      */
+    0,                                         /* tp_dictoffset     */
+    0,                                         /* tp_init           */
+    0,                                         /* tp_alloc          */
+    0,                                         /* tp_new            */
+};
@@ -0,0 +1,618 @@
+/*
+ * Copyright 2010-2020 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "packwriter.h"
+#include "utils.h"
+#include <git2/sys/odb_backend.h>
+
+/*
+ * The pack writer is an odb backend that keeps the objects written to it in
+ * memory. It is added with the highest priority, so every write made through
+ * the repository ends up here instead of in a loose object, and the objects
+ * can be read back before they reach the disk. pgit_packwriter_write then
+ * hands them to a git_packbuilder, which writes a single pack and its index
+ * into objects/pack.
+ *
+ * Each Repository attaches one pack writer on first use and keeps it: libgit2
+ * does not allow removing a backend from an odb. pgit_packwriter_acquire and
+ * pgit_packwriter_release count the users of the backend; while it has none
+ * its callbacks are cleared and the odb just skips it.
+ */
+
+typedef struct {
+    git_oid oid;
+    git_object_t type;
+    size_t len;
+    char data[1];
+} pgit_packwriter_object;
+
+typedef struct {
+    git_odb_backend parent;
+    pgit_packwriter_object **objects; /* in write order */
+    size_t n;
+    size_t alloc;
+    size_t *slots; /* open addressing, index + 1 into objects, 0 if free */
+    size_t nslots; /* a power of two */
+    size_t users;
+} pgit_packwriter;
+
+static size_t
+packwriter_hash(const git_oid *oid)
+{
+    size_t h;
+
+    memcpy(&h, oid->id, sizeof(h));
+    return h;
+}
+
+static size_t *
+packwriter_slot(pgit_packwriter *pw, const git_oid *oid)
+{
+    size_t mask = pw->nslots - 1;
+    size_t i = packwriter_hash(oid) & mask;
+
+    while (pw->slots[i] && !git_oid_equal(&pw->objects[pw->slots[i] - 1]->oid, oid))
+        i = (i + 1) & mask;
+
+    return &pw->slots[i];
+}
+
+static pgit_packwriter_object *
+packwriter_find(pgit_packwriter *pw, const git_oid *oid)
+{
+    size_t *slot;
+
+    if (pw->n == 0)
+        return NULL;
+
+    slot = packwriter_slot(pw, oid);
+    return *slot ? pw->objects[*slot - 1] : NULL;
+}
+
+static int
+packwriter_grow(pgit_packwriter *pw)
+{
+    pgit_packwriter_object **objects;
+    size_t *slots, nslots, i;
+
+    if (pw->n == pw->alloc) {
+        pw->alloc = pw->alloc ? pw->alloc * 2 : 64;
+        objects = realloc(pw->objects, pw->alloc * sizeof(*objects));
+        if (objects == NULL)
+            return -1;
+        pw->objects = objects;
+    }
+
+    /* Keep the load factor under one half */
+    if ((pw->n + 1) * 2 <= pw->nslots)
+        return 0;
+
+    nslots = pw->nslots ? pw->nslots * 2 : 128;
+    slots = calloc(nslots, sizeof(*slots));
+    if (slots == NULL)
+        return -1;
+
+    free(pw->slots);
+    pw->slots = slots;
+    pw->nslots = nslots;
+    for (i = 0; i < pw->n; i++)
+        *packwriter_slot(pw, &pw->objects[i]->oid) = i + 1;
+
+    return 0;
+}
+
+static int
+packwriter_read(void **out, size_t *len, git_object_t *type,
+                git_odb_backend *backend, const git_oid *oid)
+{
+    pgit_packwriter_object *obj;
+
+    obj = packwriter_find((pgit_packwriter *)backend, oid);
+    if (obj == NULL)
+        return GIT_ENOTFOUND;
+
+    *out = git_odb_backend_data_alloc(backend, obj->len);
+    if (*out == NULL)
+        return -1;
+
+    memcpy(*out, obj->data, obj->len);
+    *len = obj->len;
+    *type = obj->type;
+    return 0;
+}
+
+static int
+packwriter_read_header(size_t *len, git_object_t *type,
+                       git_odb_backend *backend, const git_oid *oid)
+{
+    pgit_packwriter_object *obj;
+
+    obj = packwriter_find((pgit_packwriter *)backend, oid);
+    if (obj == NULL)
+        return GIT_ENOTFOUND;
+
+    *len = obj->len;
+    *type = obj->type;
+    return 0;
+}
+
+static int
+packwriter_exists(git_odb_backend *backend, const git_oid *oid)
+{
+    return packwriter_find((pgit_packwriter *)backend, oid) != NULL;
+}
+
+/* Short ids are rare, a linear scan is enough */
+static int
+packwriter_find_prefix(pgit_packwriter_object **out, pgit_packwriter *pw,
+                       const git_oid *short_oid, size_t len)
+{
+    pgit_packwriter_object *found = NULL;
+    size_t i;
+
+    for (i = 0; i < pw->n; i++) {
+        if (git_oid_ncmp(&pw->objects[i]->oid, short_oid, len))
+            continue;
+        if (found) {
+            git_error_set_str(GIT_ERROR_ODB, "ambiguous short id");
+            return GIT_EAMBIGUOUS;
+        }
+        found = pw->objects[i];
+    }
+
+    if (found == NULL)
+        return GIT_ENOTFOUND;
+
+    *out = found;
+    return 0;
+}
+
+static int
+packwriter_read_prefix(git_oid *out_oid, void **out, size_t *len,
+                       git_object_t *type, git_odb_backend *backend,
+                       const git_oid *short_oid, size_t short_len)
+{
+    pgit_packwriter_object *obj;
+    int err;
+
+    err = packwriter_find_prefix(&obj, (pgit_packwriter *)backend, short_oid,
+                                 short_len);
+    if (err < 0)
+        return err;
+
+    *out = git_odb_backend_data_alloc(backend, obj->len);
+    if (*out == NULL)
+        return -1;
+
+    memcpy(*out, obj->data, obj->len);
+    git_oid_cpy(out_oid, &obj->oid);
+    *len = obj->len;
+    *type = obj->type;
+    return 0;
+}
+
+static int
+packwriter_exists_prefix(git_oid *out, git_odb_backend *backend,
+                         const git_oid *short_oid, size_t short_len)
+{
+    pgit_packwriter_object *obj;
+    int err;
+
+    err = packwriter_find_prefix(&obj, (pgit_packwriter *)backend, short_oid,
+                                 short_len);
+    if (err < 0)
+        return err;
+
+    git_oid_cpy(out, &obj->oid);
+    return 0;
+}
+
+static int
+packwriter_write(git_odb_backend *backend, const git_oid *oid,
+                 const void *data, size_t len, git_object_t type)
+{
+    pgit_packwriter *pw = (pgit_packwriter *)backend;
+    pgit_packwriter_object *obj;
+
+    if (packwriter_find(pw, oid))
+        return 0;
+
+    if (packwriter_grow(pw) < 0)
+        goto nomem;
+
+    obj = malloc(sizeof(pgit_packwriter_object) + len);
+    if (obj == NULL)
+        goto nomem;
+
+    git_oid_cpy(&obj->oid, oid);
+    obj->type = type;
+    obj->len = len;
+    memcpy(obj->data, data, len);
+
+    pw->objects[pw->n] = obj;
+    pw->n++;
+    *packwriter_slot(pw, oid) = pw->n;
+    return 0;
+
+nomem:
+    git_error_set_str(GIT_ERROR_NOMEMORY, "out of memory");
+    return -1;
+}
+
+static void
+packwriter_clear(pgit_packwriter *pw)
+{
+    size_t i;
+
+    for (i = 0; i < pw->n; i++)
+        free(pw->objects[i]);
+
+    if (pw->n)
+        memset(pw->slots, 0, pw->nslots * sizeof(*pw->slots));
+    pw->n = 0;
+}
+
+static void
+packwriter_free(git_odb_backend *backend)
+{
+    pgit_packwriter *pw = (pgit_packwriter *)backend;
+
+    packwriter_clear(pw);
+    free(pw->objects);
+    free(pw->slots);
+    free(pw);
+}
+
+/* Added without callbacks, pgit_packwriter_acquire sets them */
+static int
+packwriter_attach(git_odb_backend **out, git_repository *repo)
+{
+    pgit_packwriter *pw;
+    git_odb *odb;
+    int err;
+
+    err = git_repository_odb(&odb, repo);
+    if (err < 0)
+        return err;
+
+    pw = calloc(1, sizeof(pgit_packwriter));
+    if (pw == NULL) {
+        git_odb_free(odb);
+        git_error_set_str(GIT_ERROR_NOMEMORY, "out of memory");
+        return -1;
+    }
+
+    git_odb_init_backend(&pw->parent, GIT_ODB_BACKEND_VERSION);
+    pw->parent.free = packwriter_free;
+
+    /* The odb takes ownership of the backend */
+    err = git_odb_add_backend(odb, &pw->parent, PGIT_PACKWRITER_PRIORITY);
+    git_odb_free(odb);
+    if (err < 0) {
+        packwriter_free(&pw->parent);
+        return err;
+    }
+
+    *out = &pw->parent;
+    return 0;
+}
+
+int
+pgit_packwriter_acquire(git_odb_backend **out, Repository *repo)
+{
+    pgit_packwriter *pw;
+    int err;
+
+    if (repo->packwriter == NULL) {
+        err = packwriter_attach(&repo->packwriter, repo->repo);
+        if (err < 0)
+            return err;
+    }
+
+    pw = (pgit_packwriter *)repo->packwriter;
+    if (pw->users++ == 0) {
+        pw->parent.read = packwriter_read;
+        pw->parent.read_prefix = packwriter_read_prefix;
+        pw->parent.read_header = packwriter_read_header;
+        pw->parent.exists = packwriter_exists;
+        pw->parent.exists_prefix = packwriter_exists_prefix;
+        pw->parent.write = packwriter_write;
+    }
+
+    *out = repo->packwriter;
+    return 0;
+}
+
+void
+pgit_packwriter_release(git_odb_backend *backend)
+{
+    pgit_packwriter *pw = (pgit_packwriter *)backend;
+
+    if (--pw->users > 0)
+        return;
+
+    /* The objects not written by now are dropped with the last user */
+    packwriter_clear(pw);
+    pw->parent.read = NULL;
+    pw->parent.read_prefix = NULL;
+    pw->parent.read_header = NULL;
+    pw->parent.exists = NULL;
+    pw->parent.exists_prefix = NULL;
+    pw->parent.write = NULL;
+}
+
+size_t
+pgit_packwriter_count(git_odb_backend *backend)
+{
+    return ((pgit_packwriter *)backend)->n;
+}
+
+/*
+ * Whether another user holds the backend too: its objects are then left for
+ * that PackWriter to write, with its own.
+ */
+int
+pgit_packwriter_shared(git_odb_backend *backend)
+{
+    return ((pgit_packwriter *)backend)->users > 1;
+}
+
+int
+pgit_packwriter_write(git_odb_backend *backend, git_repository *repo)
+{
+    pgit_packwriter *pw = (pgit_packwriter *)backend;
+    git_packbuilder *pb = NULL;
+    git_buf path = {NULL};
+    git_odb *odb = NULL;
+    size_t i;
+    int err;
+
+    if (pw->n == 0)
+        return 0;
+
+    err = git_repository_item_path(&path, repo, GIT_REPOSITORY_ITEM_OBJECTS);
+    if (err < 0)
+        return err;
+
+    err = git_buf_grow(&path, path.size + sizeof("pack"));
+    if (err < 0)
+        goto out;
+    strcpy(path.ptr + path.size, "pack");
+    path.size += strlen("pack");
+
+    err = git_packbuilder_new(&pb, repo);
+    if (err < 0)
+        goto out;
+
+    for (i = 0; i < pw->n; i++) {
+        err = git_packbuilder_insert(pb, &pw->objects[i]->oid, NULL);
+        if (err < 0)
+            goto out;
+    }
+
+    err = git_packbuilder_write(pb, path.ptr, 0, NULL, NULL);
+    if (err < 0)
+        goto out;
+
+    /* Make the new pack visible before the objects leave memory */
+    err = git_repository_odb(&odb, repo);
+    if (err < 0)
+        goto out;
+    err = git_odb_refresh(odb);
+    if (err < 0)
+        goto out;
+
+    packwriter_clear(pw);
+
+out:
+    git_odb_free(odb);
+    git_packbuilder_free(pb);
+    git_buf_dispose(&path);
+    return err;
+}
+
+
+/*
+ * PackWriter
+ */
+
+void
+PackWriter_dealloc(PackWriter *self)
+{
+    int err;
+
+    /* Never drop objects that references may already point to */
+    if (self->backend) {
+        err = pgit_packwriter_write(self->backend, self->repo->repo);
+        if (err < 0) {
+            Error_set(err);
+            PyErr_WriteUnraisable((PyObject*)self);
+        }
+        pgit_packwriter_release(self->backend);
+    }
+
+    Py_CLEAR(self->repo);
+    PyObject_Del(self);
+}
+
+static int
+PackWriter_check_open(PackWriter *self)
+{
+    if (self->backend == NULL) {
+        PyErr_SetString(PyExc_ValueError, "pack writer is closed");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+PyDoc_STRVAR(PackWriter_write__doc__,
+    "write()\n"
+    "\n"
+    "Write the objects buffered so far as a new pack. The pack writer stays\n"
+    "open, the next objects go to another pack.");
+
+PyObject *
+PackWriter_write(PackWriter *self)
+{
+    int err;
+
+    if (PackWriter_check_open(self) < 0)
+        return NULL;
+
+    err = pgit_packwriter_write(self->backend, self->repo->repo);
+    if (err < 0)
+        return Error_set(err);
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(PackWriter_close__doc__,
+    "close()\n"
+    "\n"
+    "Write the buffered objects as a new pack, and stop capturing the\n"
+    "writes of the repository. Closing twice does nothing.");
+
+PyObject *
+PackWriter_close(PackWriter *self)
+{
+    int err;
+
+    if (self->backend == NULL)
+        Py_RETURN_NONE;
+
+    err = pgit_packwriter_write(self->backend, self->repo->repo);
+    pgit_packwriter_release(self->backend);
+    self->backend = NULL;
+    if (err < 0)
+        return Error_set(err);
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(PackWriter___enter____doc__, "");
+
+PyObject *
+PackWriter___enter__(PackWriter *self)
+{
+    if (PackWriter_check_open(self) < 0)
+        return NULL;
+
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
+
+PyDoc_STRVAR(PackWriter___exit____doc__, "");
+
+PyObject *
+PackWriter___exit__(PackWriter *self, PyObject *args)
+{
+    /* The pack is written even if the block failed, see dealloc */
+    return PackWriter_close(self);
+}
+
+
+PyMethodDef PackWriter_methods[] = {
+    METHOD(PackWriter, write, METH_NOARGS),
+    METHOD(PackWriter, close, METH_NOARGS),
+    METHOD(PackWriter, __enter__, METH_NOARGS),
+    METHOD(PackWriter, __exit__, METH_VARARGS),
+    {NULL}
+};
+
+
+Py_ssize_t
+PackWriter_len(PackWriter *self)
+{
+    if (self->backend == NULL)
+        return 0;
+
+    return (Py_ssize_t)pgit_packwriter_count(self->backend);
+}
+
+
+PyMappingMethods PackWriter_as_mapping = {
+    (lenfunc)PackWriter_len,      /* mp_length */
+    0,                            /* mp_subscript */
+    0,                            /* mp_ass_subscript */
+};
+
+
+PyDoc_STRVAR(PackWriter__doc__,
+    "PackWriter objects, returned by Repository.pack_writer(). While open,\n"
+    "the objects written to the repository are kept in memory, and written\n"
+    "as a single pack by write() or close(). Their length is the number of\n"
+    "buffered objects.");
+
+PyTypeObject PackWriterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.PackWriter",                      /* tp_name           */
+    sizeof(PackWriter),                        /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)PackWriter_dealloc,            /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    &PackWriter_as_mapping,                    /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT,                        /* tp_flags          */
+    PackWriter__doc__,                         /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    0,                                         /* tp_iter           */
+    0,                                         /* tp_iternext       */
+    PackWriter_methods,                        /* tp_methods        */
+    0,                                         /* tp_members        */
+    0,                                         /* tp_getset         */
+    0,                                         /* tp_base           */
+    0,                                         /* tp_dict           */
+    0,                                         /* tp_descr_get      */
+    0,                                         /* tp_descr_set      */
+    0,                                         /* tp_dictoffset     */
+    0,                                         /* tp_init           */
+    0,                                         /* tp_alloc          */
+    0,                                         /* tp_new            */
+};
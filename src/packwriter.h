@@ -0,0 +1,50 @@
+/*
+ * Copyright 2010-2020 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDE_pygit2_packwriter_h
+#define INCLUDE_pygit2_packwriter_h
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <git2.h>
+#include "types.h"
+
+/* Above the loose (1) and packed (2) backends libgit2 adds by default */
+#define PGIT_PACKWRITER_PRIORITY 1000
+
+int pgit_packwriter_acquire(git_odb_backend **out, Repository *repo);
+void pgit_packwriter_release(git_odb_backend *backend);
+size_t pgit_packwriter_count(git_odb_backend *backend);
+int pgit_packwriter_shared(git_odb_backend *backend);
+int pgit_packwriter_write(git_odb_backend *backend, git_repository *repo);
+
+PyObject* PackWriter_write(PackWriter *self);
+PyObject* PackWriter_close(PackWriter *self);
+PyObject* PackWriter___enter__(PackWriter *self);
+PyObject* PackWriter___exit__(PackWriter *self, PyObject *args);
+
+#endif
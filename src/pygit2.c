@@ -45,6 +45,7 @@ extern PyTypeObject OdbType;
 extern PyTypeObject OdbBackendType;
 extern PyTypeObject OdbBackendPackType;
 extern PyTypeObject OdbBackendLooseType;
+extern PyTypeObject PackWriterType;
 extern PyTypeObject OidType;
 extern PyTypeObject ObjectType;
 extern PyTypeObject CommitType;
@@ -59,6 +60,8 @@ extern PyTypeObject DiffStatsType;
 extern PyTypeObject PatchType;
 extern PyTypeObject TreeType;
 extern PyTypeObject TreeBuilderType;
+extern PyTypeObject TreeEditorType;
+extern PyTypeObject CommitTemplateType;
 extern PyTypeObject TreeIterType;
 extern PyTypeObject BlobType;
 extern PyTypeObject TagType;
@@ -75,6 +78,7 @@ extern PyTypeObject RemoteType;
 extern PyTypeObject RefspecType;
 extern PyTypeObject NoteType;
 extern PyTypeObject NoteIterType;
+extern PyTypeObject StatusIterType;
 extern PyTypeObject WorktreeType;
 extern PyTypeObject MailmapType;
 
@@ -212,6 +216,176 @@ cleanup:
 }
 
 
+PyDoc_STRVAR(index_entries_table__doc__,
+    "index_entries_table(index) -> (paths, modes, ids, stages, sizes, mtimes)\n"
+    "\n"
+    "Function exposed for Index to hook into. Read all the entries of the\n"
+    "index in one pass; 'paths' is a list, the other columns are bytes\n"
+    "holding one native uint32 (modes, sizes), 20 bytes raw id, uint8\n"
+    "(stages) or int64 nanoseconds (mtimes) per entry.");
+
+PyObject *
+index_entries_table(PyObject *self, PyObject *py_index)
+{
+    git_index *index;
+    const git_index_entry *entry;
+    char *buffer;
+    Py_ssize_t length;
+    size_t i, n;
+    PyObject *py_path;
+    PyObject *paths = NULL, *modes = NULL, *ids = NULL, *stages = NULL;
+    PyObject *sizes = NULL, *mtimes = NULL;
+    uint32_t *c_modes, *c_sizes;
+    unsigned char *c_ids, *c_stages;
+    int64_t *c_mtimes;
+
+    /* Here we need to do the opposite conversion from the _pointer getters */
+    if (PyBytes_AsStringAndSize(py_index, &buffer, &length))
+        return NULL;
+
+    if (length != sizeof(git_index *)) {
+        PyErr_SetString(PyExc_TypeError, "passed value is not a pointer");
+        return NULL;
+    }
+
+    /* the "buffer" contains the pointer */
+    index = *((git_index **) buffer);
+    n = git_index_entrycount(index);
+
+    paths = PyList_New(n);
+    modes = PyBytes_FromStringAndSize(NULL, n * sizeof(uint32_t));
+    ids = PyBytes_FromStringAndSize(NULL, n * GIT_OID_RAWSZ);
+    stages = PyBytes_FromStringAndSize(NULL, n);
+    sizes = PyBytes_FromStringAndSize(NULL, n * sizeof(uint32_t));
+    mtimes = PyBytes_FromStringAndSize(NULL, n * sizeof(int64_t));
+    if (paths == NULL || modes == NULL || ids == NULL || stages == NULL ||
+        sizes == NULL || mtimes == NULL)
+        goto error;
+
+    c_modes = (uint32_t *) PyBytes_AS_STRING(modes);
+    c_ids = (unsigned char *) PyBytes_AS_STRING(ids);
+    c_stages = (unsigned char *) PyBytes_AS_STRING(stages);
+    c_sizes = (uint32_t *) PyBytes_AS_STRING(sizes);
+    c_mtimes = (int64_t *) PyBytes_AS_STRING(mtimes);
+
+    for (i = 0; i < n; i++) {
+        entry = git_index_get_byindex(index, i);
+
+        py_path = to_path(entry->path);
+        if (py_path == NULL)
+            goto error;
+        PyList_SET_ITEM(paths, i, py_path);
+
+        c_modes[i] = entry->mode;
+        memcpy(c_ids + i * GIT_OID_RAWSZ, entry->id.id, GIT_OID_RAWSZ);
+        c_stages[i] = git_index_entry_stage(entry);
+        c_sizes[i] = entry->file_size;
+        c_mtimes[i] = (int64_t) entry->mtime.seconds * 1000000000 +
+                      entry->mtime.nanoseconds;
+    }
+
+    return Py_BuildValue("(NNNNNN)", paths, modes, ids, stages, sizes, mtimes);
+
+error:
+    Py_XDECREF(paths);
+    Py_XDECREF(modes);
+    Py_XDECREF(ids);
+    Py_XDECREF(stages);
+    Py_XDECREF(sizes);
+    Py_XDECREF(mtimes);
+    return NULL;
+}
+
+
+PyDoc_STRVAR(blame_hunks_table__doc__,
+    "blame_hunks_table(blame) -> (lines, starts, ids, orig_starts, orig_ids, boundaries, orig_paths)\n"
+    "\n"
+    "Function exposed for Blame to hook into. Read all the hunks of the\n"
+    "blame in one pass; 'orig_paths' is a list, the other columns are bytes\n"
+    "holding one native uint64 (lines, starts, orig_starts), 20 bytes raw id\n"
+    "or uint8 (boundaries) per hunk.");
+
+PyObject *
+blame_hunks_table(PyObject *self, PyObject *py_blame)
+{
+    git_blame *blame;
+    const git_blame_hunk *hunk;
+    char *buffer;
+    Py_ssize_t length;
+    uint32_t i, n;
+    PyObject *py_path;
+    PyObject *lines = NULL, *starts = NULL, *ids = NULL, *orig_starts = NULL;
+    PyObject *orig_ids = NULL, *boundaries = NULL, *orig_paths = NULL;
+    uint64_t *c_lines, *c_starts, *c_orig_starts;
+    unsigned char *c_ids, *c_orig_ids, *c_boundaries;
+
+    /* Here we need to do the opposite conversion from the _pointer getters */
+    if (PyBytes_AsStringAndSize(py_blame, &buffer, &length))
+        return NULL;
+
+    if (length != sizeof(git_blame *)) {
+        PyErr_SetString(PyExc_TypeError, "passed value is not a pointer");
+        return NULL;
+    }
+
+    /* the "buffer" contains the pointer */
+    blame = *((git_blame **) buffer);
+    n = git_blame_get_hunk_count(blame);
+
+    lines = PyBytes_FromStringAndSize(NULL, n * sizeof(uint64_t));
+    starts = PyBytes_FromStringAndSize(NULL, n * sizeof(uint64_t));
+    ids = PyBytes_FromStringAndSize(NULL, n * GIT_OID_RAWSZ);
+    orig_starts = PyBytes_FromStringAndSize(NULL, n * sizeof(uint64_t));
+    orig_ids = PyBytes_FromStringAndSize(NULL, n * GIT_OID_RAWSZ);
+    boundaries = PyBytes_FromStringAndSize(NULL, n);
+    orig_paths = PyList_New(n);
+    if (lines == NULL || starts == NULL || ids == NULL || orig_starts == NULL ||
+        orig_ids == NULL || boundaries == NULL || orig_paths == NULL)
+        goto error;
+
+    c_lines = (uint64_t *) PyBytes_AS_STRING(lines);
+    c_starts = (uint64_t *) PyBytes_AS_STRING(starts);
+    c_ids = (unsigned char *) PyBytes_AS_STRING(ids);
+    c_orig_starts = (uint64_t *) PyBytes_AS_STRING(orig_starts);
+    c_orig_ids = (unsigned char *) PyBytes_AS_STRING(orig_ids);
+    c_boundaries = (unsigned char *) PyBytes_AS_STRING(boundaries);
+
+    for (i = 0; i < n; i++) {
+        hunk = git_blame_get_hunk_byindex(blame, i);
+
+        if (hunk->orig_path) {
+            py_path = to_path(hunk->orig_path);
+            if (py_path == NULL)
+                goto error;
+        } else {
+            py_path = Py_None;
+            Py_INCREF(py_path);
+        }
+        PyList_SET_ITEM(orig_paths, i, py_path);
+
+        c_lines[i] = hunk->lines_in_hunk;
+        c_starts[i] = hunk->final_start_line_number;
+        memcpy(c_ids + i * GIT_OID_RAWSZ, hunk->final_commit_id.id, GIT_OID_RAWSZ);
+        c_orig_starts[i] = hunk->orig_start_line_number;
+        memcpy(c_orig_ids + i * GIT_OID_RAWSZ, hunk->orig_commit_id.id, GIT_OID_RAWSZ);
+        c_boundaries[i] = hunk->boundary != 0;
+    }
+
+    return Py_BuildValue("(NNNNNNN)", lines, starts, ids, orig_starts,
+                         orig_ids, boundaries, orig_paths);
+
+error:
+    Py_XDECREF(lines);
+    Py_XDECREF(starts);
+    Py_XDECREF(ids);
+    Py_XDECREF(orig_starts);
+    Py_XDECREF(orig_ids);
+    Py_XDECREF(boundaries);
+    Py_XDECREF(orig_paths);
+    return NULL;
+}
+
+
 PyDoc_STRVAR(reference_is_valid_name__doc__,
     "reference_is_valid_name(refname) -> bool\n"
     "\n"
@@ -258,9 +432,11 @@ tree_entry_cmp(PyObject *self, PyObject *args)
 
 
 PyMethodDef module_methods[] = {
+    {"blame_hunks_table", blame_hunks_table, METH_O, blame_hunks_table__doc__},
     {"discover_repository", discover_repository, METH_VARARGS, discover_repository__doc__},
     {"hash", hash, METH_VARARGS, hash__doc__},
     {"hashfile", hashfile, METH_VARARGS, hashfile__doc__},
+    {"index_entries_table", index_entries_table, METH_O, index_entries_table__doc__},
     {"init_file_backend", init_file_backend, METH_VARARGS, init_file_backend__doc__},
     {"option", option, METH_VARARGS, option__doc__},
     {"reference_is_valid_name", reference_is_valid_name, METH_O, reference_is_valid_name__doc__},
@@ -343,6 +519,8 @@ PyInit__pygit2(void)
     ADD_TYPE(m, OdbBackendPack)
     INIT_TYPE(OdbBackendLooseType, &OdbBackendType, PyType_GenericNew)
     ADD_TYPE(m, OdbBackendLoose)
+    INIT_TYPE(PackWriterType, NULL, NULL)
+    ADD_TYPE(m, PackWriter)
 
     /* Oid */
     INIT_TYPE(OidType, NULL, PyType_GenericNew)
@@ -361,6 +539,8 @@ PyInit__pygit2(void)
     INIT_TYPE(TreeType, &ObjectType, NULL)
     INIT_TYPE(TreeIterType, NULL, NULL)
     INIT_TYPE(TreeBuilderType, NULL, NULL)
+    INIT_TYPE(TreeEditorType, NULL, NULL)
+    INIT_TYPE(CommitTemplateType, NULL, NULL)
     INIT_TYPE(BlobType, &ObjectType, NULL)
     INIT_TYPE(TagType, &ObjectType, NULL)
     ADD_TYPE(m, Object)
@@ -368,6 +548,8 @@ PyInit__pygit2(void)
     ADD_TYPE(m, Signature)
     ADD_TYPE(m, Tree)
     ADD_TYPE(m, TreeBuilder)
+    ADD_TYPE(m, TreeEditor)
+    ADD_TYPE(m, CommitTemplate)
     ADD_TYPE(m, Blob)
     ADD_TYPE(m, Tag)
     ADD_CONSTANT_INT(m, GIT_OBJ_ANY)
@@ -443,6 +625,7 @@ PyInit__pygit2(void)
      * Index & Working copy
      */
     /* Status */
+    INIT_TYPE(StatusIterType, NULL, NULL)
     ADD_CONSTANT_INT(m, GIT_STATUS_CURRENT)
     ADD_CONSTANT_INT(m, GIT_STATUS_INDEX_NEW)
     ADD_CONSTANT_INT(m, GIT_STATUS_INDEX_MODIFIED)
@@ -457,6 +640,27 @@ PyInit__pygit2(void)
     ADD_CONSTANT_INT(m, GIT_STATUS_WT_UNREADABLE)
     ADD_CONSTANT_INT(m, GIT_STATUS_IGNORED) /* Flags for ignored files */
     ADD_CONSTANT_INT(m, GIT_STATUS_CONFLICTED)
+    /* What status should compare (git_status_show_t in libgit2) */
+    ADD_CONSTANT_INT(m, GIT_STATUS_SHOW_INDEX_AND_WORKDIR)
+    ADD_CONSTANT_INT(m, GIT_STATUS_SHOW_INDEX_ONLY)
+    ADD_CONSTANT_INT(m, GIT_STATUS_SHOW_WORKDIR_ONLY)
+    /* Status options (git_status_opt_t in libgit2) */
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_INCLUDE_UNTRACKED)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_INCLUDE_IGNORED)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_INCLUDE_UNMODIFIED)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_EXCLUDE_SUBMODULES)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_DISABLE_PATHSPEC_MATCH)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_RECURSE_IGNORED_DIRS)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_RENAMES_INDEX_TO_WORKDIR)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_SORT_CASE_SENSITIVELY)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_SORT_CASE_INSENSITIVELY)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_RENAMES_FROM_REWRITES)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_NO_REFRESH)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_UPDATE_INDEX)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_INCLUDE_UNREADABLE)
+    ADD_CONSTANT_INT(m, GIT_STATUS_OPT_INCLUDE_UNREADABLE_AS_UNTRACKED)
     /* Different checkout strategies */
     ADD_CONSTANT_INT(m, GIT_CHECKOUT_NONE)
     ADD_CONSTANT_INT(m, GIT_CHECKOUT_SAFE)
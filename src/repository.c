@@ -31,17 +31,21 @@
 #include "types.h"
 #include "reference.h"
 #include "utils.h"
+#include "commit.h"
 #include "odb.h"
 #include "object.h"
 #include "oid.h"
+#include "packwriter.h"
 #include "note.h"
 #include "refdb.h"
 #include "repository.h"
+#include "archive.h"
 #include "diff.h"
 #include "branch.h"
 #include "signature.h"
 #include "worktree.h"
 #include <git2/odb_backend.h>
+#include <git2/sys/commit.h>
 #include <git2/sys/repository.h>
 
 extern PyObject *GitError;
@@ -54,11 +58,15 @@ extern PyTypeObject OidType;
 extern PyTypeObject CommitType;
 extern PyTypeObject TreeType;
 extern PyTypeObject TreeBuilderType;
+extern PyTypeObject TreeEditorType;
+extern PyTypeObject PackWriterType;
+extern PyTypeObject CommitTemplateType;
 extern PyTypeObject ConfigType;
 extern PyTypeObject DiffType;
 extern PyTypeObject ReferenceType;
 extern PyTypeObject NoteType;
 extern PyTypeObject NoteIterType;
+extern PyTypeObject StatusIterType;
 
 /* forward-declaration for Repsository._from_c() */
 PyTypeObject RepositoryType;
@@ -73,6 +81,7 @@ wrap_repository(git_repository *c_repo)
         py_repo->config = NULL;
         py_repo->index = NULL;
         py_repo->owned = 1;
+        py_repo->packwriter = NULL;
     }
 
     return (PyObject *)py_repo;
@@ -103,6 +112,7 @@ Repository_init(Repository *self, PyObject *args, PyObject *kwds)
         self->owned = 1;
         self->config = NULL;
         self->index = NULL;
+        self->packwriter = NULL;
         return 0;
     }
 
@@ -115,6 +125,7 @@ Repository_init(Repository *self, PyObject *args, PyObject *kwds)
     self->owned = 1;
     self->config = NULL;
     self->index = NULL;
+    self->packwriter = NULL;
 
     return 0;
 }
@@ -131,6 +142,7 @@ Repository__from_c(Repository *py_repo, PyObject *args)
     py_repo->repo = NULL;
     py_repo->config = NULL;
     py_repo->index = NULL;
+    py_repo->packwriter = NULL;
 
     if (!PyArg_ParseTuple(args, "OO!", &py_pointer, &PyBool_Type, &py_free))
         return NULL;
@@ -593,6 +605,154 @@ Repository_merge(Repository *self, PyObject *py_oid)
     Py_RETURN_NONE;
 }
 
+static int
+Repository_peel_tree(git_tree **out, git_repository *repo, PyObject *py_id)
+{
+    git_object *obj;
+    git_oid oid;
+    int err;
+
+    *out = NULL;
+    if (py_id == Py_None)
+        return 0;
+
+    err = py_oid_to_git_oid_expand(repo, py_id, &oid);
+    if (err < 0)
+        return -1;
+
+    err = git_object_lookup(&obj, repo, &oid, GIT_OBJ_ANY);
+    if (err < 0) {
+        Error_set(err);
+        return -1;
+    }
+
+    err = git_object_peel((git_object **) out, obj, GIT_OBJ_TREE);
+    git_object_free(obj);
+    if (err < 0) {
+        Error_set(err);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+Repository_conflict_paths(PyObject *py_paths, git_index *index)
+{
+    git_index_conflict_iterator *iter;
+    const git_index_entry *a, *o, *t;
+    PyObject *py_path;
+    int err;
+
+    err = git_index_conflict_iterator_new(&iter, index);
+    if (err < 0) {
+        Error_set(err);
+        return -1;
+    }
+
+    while ((err = git_index_conflict_next(&a, &o, &t, iter)) == 0) {
+        py_path = to_path(o ? o->path : (t ? t->path : a->path));
+        if (py_path == NULL || PyList_Append(py_paths, py_path) < 0) {
+            Py_XDECREF(py_path);
+            git_index_conflict_iterator_free(iter);
+            return -1;
+        }
+        Py_DECREF(py_path);
+    }
+    git_index_conflict_iterator_free(iter);
+
+    if (err != GIT_ITEROVER) {
+        Error_set(err);
+        return -1;
+    }
+
+    return 0;
+}
+
+PyDoc_STRVAR(Repository__merge_check__doc__,
+  "_merge_check(ancestor, ours, theirs[, file_favor, release_gil]) -> (bool, list, Oid)\n"
+  "\n"
+  "Merge the trees of the given ids in memory, without building an Index\n"
+  "object. Returns (True, [], tree_id) when the merge is clean, or\n"
+  "(False, paths, None) with the conflicting paths otherwise. The\n"
+  "ancestor may be None.\n"
+  "\n"
+  "The GIL is only released with release_gil, when no other thread may\n"
+  "use this repository handle.");
+
+PyObject *
+Repository__merge_check(Repository *self, PyObject *args)
+{
+    PyObject *py_ancestor, *py_ours, *py_theirs;
+    PyObject *py_paths = NULL, *py_result = NULL;
+    unsigned int file_favor = GIT_MERGE_FILE_FAVOR_NORMAL;
+    int release_gil = 0;
+    git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+    git_tree *ancestor = NULL, *ours = NULL, *theirs = NULL;
+    git_index *index = NULL;
+    git_oid tree_id;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "OOO|Ip", &py_ancestor, &py_ours, &py_theirs,
+                          &file_favor, &release_gil))
+        return NULL;
+
+    if (Repository_peel_tree(&ancestor, self->repo, py_ancestor) < 0 ||
+        Repository_peel_tree(&ours, self->repo, py_ours) < 0 ||
+        Repository_peel_tree(&theirs, self->repo, py_theirs) < 0)
+        goto out;
+
+    opts.file_favor = file_favor;
+
+    if (release_gil) {
+        Py_BEGIN_ALLOW_THREADS;
+        err = git_merge_trees(&index, self->repo, ancestor, ours, theirs, &opts);
+        Py_END_ALLOW_THREADS;
+    } else {
+        err = git_merge_trees(&index, self->repo, ancestor, ours, theirs, &opts);
+    }
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_paths = PyList_New(0);
+    if (py_paths == NULL)
+        goto out;
+
+    if (!git_index_has_conflicts(index)) {
+        if (release_gil) {
+            Py_BEGIN_ALLOW_THREADS;
+            err = git_index_write_tree_to(&tree_id, index, self->repo);
+            Py_END_ALLOW_THREADS;
+        } else {
+            err = git_index_write_tree_to(&tree_id, index, self->repo);
+        }
+        if (err < 0) {
+            Error_set(err);
+            goto out;
+        }
+
+        py_result = Py_BuildValue("ONN", Py_True, py_paths,
+                                  git_oid_to_python(&tree_id));
+        py_paths = NULL;
+        goto out;
+    }
+
+    if (Repository_conflict_paths(py_paths, index) < 0)
+        goto out;
+
+    py_result = Py_BuildValue("OOO", Py_False, py_paths, Py_None);
+
+out:
+    Py_XDECREF(py_paths);
+    git_index_free(index);
+    git_tree_free(ancestor);
+    git_tree_free(ours);
+    git_tree_free(theirs);
+    return py_result;
+}
+
 PyDoc_STRVAR(Repository_cherrypick__doc__,
   "cherrypick(id)\n"
   "\n"
@@ -870,6 +1030,78 @@ cleanup:
 }
 
 
+/*
+ * The arguments shared by create_commit and create_commit_buffer, with the
+ * tree and the parents loaded.
+ */
+typedef struct {
+    PyObject *tmessage;
+    const char *message;
+    git_tree *tree;
+    git_commit **parents;
+    int parent_count;
+} Repository_commit_args;
+
+static int
+Repository_commit_args_load(Repository *self, Repository_commit_args *ca,
+                            PyObject *py_message, const char *encoding,
+                            PyObject *py_oid, PyObject *py_parents)
+{
+    git_oid oid;
+    size_t len;
+    int err, n;
+
+    memset(ca, 0, sizeof(*ca));
+
+    len = py_oid_to_git_oid(py_oid, &oid);
+    if (len == 0)
+        return -1;
+
+    ca->message = pgit_borrow_encoding(py_message, encoding, &ca->tmessage);
+    if (ca->message == NULL)
+        return -1;
+
+    err = git_tree_lookup_prefix(&ca->tree, self->repo, &oid, len);
+    if (err < 0) {
+        Error_set(err);
+        return -1;
+    }
+
+    n = (int)PyList_Size(py_parents);
+    ca->parents = malloc(n * sizeof(git_commit*));
+    if (ca->parents == NULL) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+    for (; ca->parent_count < n; ca->parent_count++) {
+        len = py_oid_to_git_oid(PyList_GET_ITEM(py_parents, ca->parent_count),
+                                &oid);
+        if (len == 0)
+            return -1;
+        err = git_commit_lookup_prefix(&ca->parents[ca->parent_count],
+                                       self->repo, &oid, len);
+        if (err < 0) {
+            Error_set(err);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void
+Repository_commit_args_free(Repository_commit_args *ca)
+{
+    Py_XDECREF(ca->tmessage);
+    git_tree_free(ca->tree);
+    while (ca->parent_count > 0) {
+        ca->parent_count--;
+        git_commit_free(ca->parents[ca->parent_count]);
+    }
+    free(ca->parents);
+}
+
+
 PyDoc_STRVAR(Repository_create_commit__doc__,
   "create_commit(reference_name, author, committer, message, tree, parents[, encoding]) -> Oid\n"
   "\n"
@@ -879,15 +1111,13 @@ PyObject *
 Repository_create_commit(Repository *self, PyObject *args)
 {
     Signature *py_author, *py_committer;
-    PyObject *py_oid, *py_message, *py_parents, *py_parent;
+    PyObject *py_oid, *py_message, *py_parents;
     PyObject *py_result = NULL;
+    Repository_commit_args ca;
     char *update_ref = NULL;
     char *encoding = NULL;
     git_oid oid;
-    git_tree *tree = NULL;
-    int parent_count;
-    git_commit **parents = NULL;
-    int i = 0;
+    int err;
 
     if (!PyArg_ParseTuple(args, "zO!O!OOO!|s",
                           &update_ref,
@@ -899,62 +1129,664 @@ Repository_create_commit(Repository *self, PyObject *args)
                           &encoding))
         return NULL;
 
-    size_t len = py_oid_to_git_oid(py_oid, &oid);
-    if (len == 0)
+    if (Repository_commit_args_load(self, &ca, py_message, encoding, py_oid,
+                                    py_parents) < 0)
+        goto out;
+
+    err = git_commit_create(&oid, self->repo, update_ref,
+                            py_author->signature, py_committer->signature,
+                            encoding, ca.message, ca.tree, ca.parent_count,
+                            (const git_commit**)ca.parents);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = git_oid_to_python(&oid);
+
+out:
+    Repository_commit_args_free(&ca);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_create_commit_from_ids__doc__,
+  "create_commit_from_ids(reference_name, author, committer, message, tree, parents, encoding=None, validate=True) -> Oid\n"
+  "\n"
+  "Create a new commit object from the ids of its tree and parents, return\n"
+  "its oid.\n"
+  "\n"
+  "Unlike create_commit, the tree and parents are not loaded and parsed;\n"
+  "this is the fast path for writing many commits. Short ids are expanded\n"
+  "with an object database existence check.\n"
+  "\n"
+  "Parameters:\n"
+  "\n"
+  "parents\n"
+  "    Sequence of Oid objects or hex strings.\n"
+  "\n"
+  "validate\n"
+  "    If False, do not check that the tree and the parents exist and have\n"
+  "    the right type, even with GIT_OPT_ENABLE_STRICT_OBJECT_CREATION\n"
+  "    enabled; the caller guarantees it.");
+
+PyObject *
+Repository_create_commit_from_ids(Repository *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"reference_name", "author", "committer", "message",
+                             "tree", "parents", "encoding", "validate", NULL};
+    Signature *py_author, *py_committer;
+    PyObject *py_tree, *py_message, *py_parents, *parents = NULL;
+    PyObject *tmessage = NULL;
+    PyObject *py_result = NULL;
+    const char *message;
+    char *update_ref = NULL;
+    char *encoding = NULL;
+    int validate = 1;
+    git_oid oid, tree_id;
+    git_oid *parent_ids = NULL;
+    const git_oid **parent_ptrs = NULL;
+    Py_ssize_t i, parent_count;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "zO!O!OOO|zp", kwlist,
+                                     &update_ref,
+                                     &SignatureType, &py_author,
+                                     &SignatureType, &py_committer,
+                                     &py_message,
+                                     &py_tree,
+                                     &py_parents,
+                                     &encoding,
+                                     &validate))
+        return NULL;
+
+    if (py_oid_to_git_oid_expand(self->repo, py_tree, &tree_id) < 0)
         return NULL;
 
-    PyObject *tmessage;
-    const char *message = pgit_borrow_encoding(py_message, encoding, &tmessage);
-    if (message == NULL)
+    parents = PySequence_Fast(py_parents, "parents must be a sequence");
+    if (parents == NULL)
+        return NULL;
+
+    parent_count = PySequence_Fast_GET_SIZE(parents);
+    parent_ids = malloc((parent_count + 1) * sizeof(git_oid));
+    parent_ptrs = malloc((parent_count + 1) * sizeof(git_oid*));
+    if (parent_ids == NULL || parent_ptrs == NULL) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto out;
+    }
+    for (i = 0; i < parent_count; i++) {
+        if (py_oid_to_git_oid_expand(self->repo,
+                                     PySequence_Fast_GET_ITEM(parents, i),
+                                     &parent_ids[i]) < 0)
+            goto out;
+        parent_ptrs[i] = &parent_ids[i];
+    }
+
+    message = pgit_borrow_encoding(py_message, encoding, &tmessage);
+    if (message == NULL)
+        goto out;
+
+    err = pgit_commit_create_from_ids(&oid, self->repo, update_ref,
+                                      py_author->signature,
+                                      py_committer->signature,
+                                      encoding, message, &tree_id,
+                                      (size_t)parent_count, parent_ptrs,
+                                      validate);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = git_oid_to_python(&oid);
+
+out:
+    Py_XDECREF(tmessage);
+    Py_DECREF(parents);
+    free(parent_ids);
+    free(parent_ptrs);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_create_commit_buffer__doc__,
+  "create_commit_buffer(author, committer, message, tree, parents[, encoding]) -> bytes\n"
+  "\n"
+  "Return the raw contents of the commit create_commit would write, without\n"
+  "writing it.");
+
+PyObject *
+Repository_create_commit_buffer(Repository *self, PyObject *args)
+{
+    Signature *py_author, *py_committer;
+    PyObject *py_oid, *py_message, *py_parents;
+    PyObject *py_result = NULL;
+    Repository_commit_args ca;
+    char *encoding = NULL;
+    git_buf buf = {NULL};
+    int err;
+
+    if (!PyArg_ParseTuple(args, "O!O!OOO!|s",
+                          &SignatureType, &py_author,
+                          &SignatureType, &py_committer,
+                          &py_message,
+                          &py_oid,
+                          &PyList_Type, &py_parents,
+                          &encoding))
+        return NULL;
+
+    if (Repository_commit_args_load(self, &ca, py_message, encoding, py_oid,
+                                    py_parents) < 0)
+        goto out;
+
+    err = git_commit_create_buffer(&buf, self->repo,
+                                   py_author->signature, py_committer->signature,
+                                   encoding, ca.message, ca.tree,
+                                   ca.parent_count,
+                                   (const git_commit**)ca.parents);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = PyBytes_FromStringAndSize(buf.ptr, buf.size);
+
+out:
+    Repository_commit_args_free(&ca);
+    git_buf_dispose(&buf);
+    return py_result;
+}
+
+
+/*
+ * Point update_ref, or the reference it ends up at if it is symbolic, to the
+ * given commit. The target may not exist yet, e.g. HEAD on an unborn branch.
+ */
+static int
+Repository_update_ref_to(git_repository *repo, const char *update_ref,
+                         const git_oid *oid, const char *log_message)
+{
+    git_reference *ref = NULL;
+    char *name;
+    int depth, err;
+
+    name = strdup(update_ref);
+    if (name == NULL)
+        return -1;
+
+    for (depth = 0; depth < 5; depth++) {
+        err = git_reference_lookup(&ref, repo, name);
+        if (err == GIT_ENOTFOUND)
+            break;
+        if (err < 0)
+            goto out;
+        if (git_reference_type(ref) != GIT_REF_SYMBOLIC)
+            break;
+
+        free(name);
+        name = strdup(git_reference_symbolic_target(ref));
+        git_reference_free(ref);
+        ref = NULL;
+        if (name == NULL)
+            return -1;
+    }
+
+    git_reference_free(ref);
+    ref = NULL;
+    err = git_reference_create(&ref, repo, name, oid, 1, log_message);
+
+out:
+    git_reference_free(ref);
+    free(name);
+    return err;
+}
+
+PyDoc_STRVAR(Repository_create_commits__doc__,
+  "create_commits(records, update_ref=None, validate=True,\n"
+  "               chunk_size=100000) -> [Oid, ...]\n"
+  "\n"
+  "Create many commits at once, return their oids.\n"
+  "\n"
+  "The commits are written into packs instead of one loose object each,\n"
+  "and update_ref, if given, is updated once to point to the last commit.\n"
+  "Inside a pack_writer() block they are left to that PackWriter instead,\n"
+  "which writes them with its own objects.\n"
+  "\n"
+  "Parameters:\n"
+  "\n"
+  "records\n"
+  "    Iterable of (author, committer, message, tree, parents[, encoding])\n"
+  "    tuples, like the arguments of create_commit. Besides Oid objects and\n"
+  "    hex strings, parents may hold the index of a previous record, to\n"
+  "    refer to the commit created for it.\n"
+  "\n"
+  "validate\n"
+  "    Like in create_commit_from_ids.\n"
+  "\n"
+  "chunk_size\n"
+  "    The commits are kept in memory until they are written, one pack\n"
+  "    per chunk_size commits.");
+
+PyObject *
+Repository_create_commits(Repository *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"records", "update_ref", "validate", "chunk_size",
+                             NULL};
+    Signature *py_author, *py_committer;
+    PyObject *py_records, *py_message, *py_tree, *py_parents, *py_parent;
+    PyObject *iter = NULL, *record = NULL, *parents = NULL, *tmessage = NULL;
+    PyObject *py_oid, *oids = NULL;
+    PyObject *py_result = NULL;
+    const char *message;
+    char *update_ref = NULL;
+    char *encoding;
+    char log_message[64];
+    int validate = 1;
+    git_odb_backend *backend;
+    git_oid oid, tree_id;
+    git_oid *parent_ids = NULL;
+    const git_oid **parent_ptrs = NULL;
+    Py_ssize_t i, index, parent_count, alloc = 0;
+    Py_ssize_t chunk_size = 100000;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|zpn", kwlist,
+                                     &py_records, &update_ref, &validate,
+                                     &chunk_size))
+        return NULL;
+
+    if (chunk_size <= 0) {
+        PyErr_SetString(PyExc_ValueError, "chunk_size must be positive");
+        return NULL;
+    }
+
+    iter = PyObject_GetIter(py_records);
+    if (iter == NULL)
+        return NULL;
+
+    oids = PyList_New(0);
+    if (oids == NULL)
+        goto cleanup;
+
+    err = pgit_packwriter_acquire(&backend, self);
+    if (err < 0) {
+        Error_set(err);
+        goto cleanup;
+    }
+
+    while ((record = PyIter_Next(iter)) != NULL) {
+        encoding = NULL;
+        if (!PyTuple_Check(record)) {
+            PyErr_SetString(PyExc_TypeError, "records must be tuples");
+            goto release;
+        }
+        if (!PyArg_ParseTuple(record, "O!O!OOO|z",
+                              &SignatureType, &py_author,
+                              &SignatureType, &py_committer,
+                              &py_message,
+                              &py_tree,
+                              &py_parents,
+                              &encoding))
+            goto release;
+
+        if (py_oid_to_git_oid_expand(self->repo, py_tree, &tree_id) < 0)
+            goto release;
+
+        parents = PySequence_Fast(py_parents, "parents must be a sequence");
+        if (parents == NULL)
+            goto release;
+
+        parent_count = PySequence_Fast_GET_SIZE(parents);
+        if (parent_count > alloc) {
+            alloc = parent_count;
+            free(parent_ids);
+            free(parent_ptrs);
+            parent_ids = malloc(alloc * sizeof(git_oid));
+            parent_ptrs = malloc(alloc * sizeof(git_oid*));
+            if (parent_ids == NULL || parent_ptrs == NULL) {
+                PyErr_SetNone(PyExc_MemoryError);
+                goto release;
+            }
+        }
+        for (i = 0; i < parent_count; i++) {
+            py_parent = PySequence_Fast_GET_ITEM(parents, i);
+            if (PyLong_Check(py_parent)) {
+                index = PyLong_AsSsize_t(py_parent);
+                if (index < 0 || index >= PyList_GET_SIZE(oids)) {
+                    if (!PyErr_Occurred())
+                        PyErr_SetString(PyExc_IndexError,
+                                        "parent index out of range");
+                    goto release;
+                }
+                py_oid = PyList_GET_ITEM(oids, index);
+                git_oid_cpy(&parent_ids[i], &((Oid*)py_oid)->oid);
+            } else if (py_oid_to_git_oid_expand(self->repo, py_parent,
+                                                &parent_ids[i]) < 0) {
+                goto release;
+            }
+            parent_ptrs[i] = &parent_ids[i];
+        }
+
+        message = pgit_borrow_encoding(py_message, encoding, &tmessage);
+        if (message == NULL)
+            goto release;
+
+        err = pgit_commit_create_from_ids(&oid, self->repo, NULL,
+                                          py_author->signature,
+                                          py_committer->signature,
+                                          encoding, message, &tree_id,
+                                          (size_t)parent_count, parent_ptrs,
+                                          validate);
+        if (err < 0) {
+            Error_set(err);
+            goto release;
+        }
+
+        py_oid = git_oid_to_python(&oid);
+        if (py_oid == NULL || PyList_Append(oids, py_oid) < 0) {
+            Py_XDECREF(py_oid);
+            goto release;
+        }
+        Py_DECREF(py_oid);
+
+        Py_CLEAR(tmessage);
+        Py_CLEAR(parents);
+        Py_CLEAR(record);
+
+        if (!pgit_packwriter_shared(backend) &&
+            pgit_packwriter_count(backend) >= (size_t)chunk_size) {
+            err = pgit_packwriter_write(backend, self->repo);
+            if (err < 0) {
+                Error_set(err);
+                goto release;
+            }
+        }
+    }
+    if (PyErr_Occurred())
+        goto release;
+
+    if (!pgit_packwriter_shared(backend)) {
+        err = pgit_packwriter_write(backend, self->repo);
+        if (err < 0) {
+            Error_set(err);
+            goto release;
+        }
+    }
+
+    if (update_ref && PyList_GET_SIZE(oids) > 0) {
+        PyOS_snprintf(log_message, sizeof(log_message),
+                      "commit (batch): %zd commits", PyList_GET_SIZE(oids));
+        err = Repository_update_ref_to(self->repo, update_ref, &oid,
+                                       log_message);
+        if (err < 0) {
+            Error_set(err);
+            goto release;
+        }
+    }
+
+    py_result = oids;
+    oids = NULL;
+
+release:
+    /* On error the objects of the last chunk are dropped, unless a
+     * PackWriter still uses the backend */
+    pgit_packwriter_release(backend);
+
+cleanup:
+    Py_XDECREF(tmessage);
+    Py_XDECREF(parents);
+    Py_XDECREF(record);
+    Py_XDECREF(oids);
+    Py_DECREF(iter);
+    free(parent_ids);
+    free(parent_ptrs);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository__replay_commits__doc__,
+  "_replay_commits(commits, onto, committer=None, file_favor=0,\n"
+  "                update_ref=None, validate=True)\n"
+  "    -> ([Oid, ...], Oid, Oid, [str, ...])\n"
+  "\n"
+  "Replay the changes of the given commits on top of onto, in memory,\n"
+  "without touching the working directory or the index.\n"
+  "\n"
+  "Every commit is cherry-picked onto the previous new commit, against\n"
+  "its first parent, and keeps its author and message. The new commits\n"
+  "are written into a single pack. The replay stops on the first commit\n"
+  "that does not merge cleanly.\n"
+  "\n"
+  "Returns (new commit ids, last tree id, id of the conflicting commit,\n"
+  "conflicting paths); the last two are None and [] when every commit was\n"
+  "replayed, in which case update_ref, if given, is set to the last new\n"
+  "commit.");
+
+PyObject *
+Repository__replay_commits(Repository *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"commits", "onto", "committer", "file_favor",
+                             "update_ref", "validate", NULL};
+    PyObject *py_commits, *py_onto, *py_committer = Py_None, *py_item;
+    PyObject *iter = NULL, *oids = NULL, *py_paths = NULL, *py_oid;
+    PyObject *py_stopped = NULL, *py_result = NULL;
+    unsigned int file_favor = GIT_MERGE_FILE_FAVOR_NORMAL;
+    char *update_ref = NULL;
+    char log_message[64];
+    int validate = 1;
+    git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+    git_odb_backend *backend;
+    git_commit *commit = NULL, *parent = NULL;
+    git_tree *ancestor = NULL, *ours = NULL, *theirs = NULL;
+    git_index *index = NULL;
+    const git_signature *committer;
+    const git_oid *parent_ptr;
+    git_oid oid, head_id, tree_id;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|OIzp", kwlist,
+                                     &py_commits, &py_onto, &py_committer,
+                                     &file_favor, &update_ref, &validate))
+        return NULL;
+
+    if (py_committer != Py_None &&
+        !PyObject_TypeCheck(py_committer, &SignatureType)) {
+        PyErr_SetString(PyExc_TypeError, "committer must be a Signature");
+        return NULL;
+    }
+    opts.file_favor = file_favor;
+
+    if (py_oid_to_git_oid_expand(self->repo, py_onto, &oid) < 0)
+        return NULL;
+    err = git_commit_lookup(&commit, self->repo, &oid);
+    if (err < 0)
+        return Error_set(err);
+    git_oid_cpy(&head_id, git_commit_id(commit));
+    git_oid_cpy(&tree_id, git_commit_tree_id(commit));
+    git_commit_free(commit);
+    commit = NULL;
+
+    iter = PyObject_GetIter(py_commits);
+    if (iter == NULL)
         return NULL;
 
-    int err = git_tree_lookup_prefix(&tree, self->repo, &oid, len);
+    oids = PyList_New(0);
+    py_paths = PyList_New(0);
+    if (oids == NULL || py_paths == NULL)
+        goto cleanup;
+
+    err = pgit_packwriter_acquire(&backend, self);
     if (err < 0) {
         Error_set(err);
-        goto out;
+        goto cleanup;
     }
 
-    parent_count = (int)PyList_Size(py_parents);
-    parents = malloc(parent_count * sizeof(git_commit*));
-    if (parents == NULL) {
-        PyErr_SetNone(PyExc_MemoryError);
-        goto out;
-    }
-    for (; i < parent_count; i++) {
-        py_parent = PyList_GET_ITEM(py_parents, i);
-        len = py_oid_to_git_oid(py_parent, &oid);
-        if (len == 0)
-            goto out;
-        err = git_commit_lookup_prefix(&parents[i], self->repo, &oid, len);
+    while ((py_item = PyIter_Next(iter)) != NULL) {
+        err = py_oid_to_git_oid_expand(self->repo, py_item, &oid);
+        Py_DECREF(py_item);
+        if (err < 0)
+            goto release;
+
+        err = git_commit_lookup(&commit, self->repo, &oid);
+        if (err == 0)
+            err = git_commit_tree(&theirs, commit);
+        if (err == 0 && git_commit_parentcount(commit) > 0) {
+            err = git_commit_parent(&parent, commit, 0);
+            if (err == 0)
+                err = git_commit_tree(&ancestor, parent);
+        }
         if (err < 0) {
             Error_set(err);
-            goto out;
+            goto release;
+        }
+
+        if (ancestor && git_oid_equal(git_tree_id(ancestor), &tree_id)) {
+            /* The commit applies as is, no need to merge */
+            git_oid_cpy(&tree_id, git_tree_id(theirs));
+        } else {
+            err = git_tree_lookup(&ours, self->repo, &tree_id);
+            if (err < 0) {
+                Error_set(err);
+                goto release;
+            }
+
+            /* The GIL is kept: self->repo and its pack writer are shared */
+            err = git_merge_trees(&index, self->repo, ancestor, ours, theirs,
+                                  &opts);
+            if (err == 0 && !git_index_has_conflicts(index))
+                err = git_index_write_tree_to(&tree_id, index, self->repo);
+            if (err < 0) {
+                Error_set(err);
+                goto release;
+            }
+
+            if (git_index_has_conflicts(index)) {
+                if (Repository_conflict_paths(py_paths, index) < 0)
+                    goto release;
+                py_stopped = git_oid_to_python(git_commit_id(commit));
+                if (py_stopped == NULL)
+                    goto release;
+                break;
+            }
+        }
+
+        committer = git_commit_committer(commit);
+        if (py_committer != Py_None)
+            committer = ((Signature*)py_committer)->signature;
+        parent_ptr = &head_id;
+        err = pgit_commit_create_from_ids(&oid, self->repo, NULL,
+                                          git_commit_author(commit), committer,
+                                          git_commit_message_encoding(commit),
+                                          git_commit_message_raw(commit),
+                                          &tree_id, 1, &parent_ptr, validate);
+        if (err < 0) {
+            Error_set(err);
+            goto release;
         }
+        git_oid_cpy(&head_id, &oid);
+
+        py_oid = git_oid_to_python(&head_id);
+        if (py_oid == NULL || PyList_Append(oids, py_oid) < 0) {
+            Py_XDECREF(py_oid);
+            goto release;
+        }
+        Py_DECREF(py_oid);
+
+        git_index_free(index);
+        git_tree_free(ours);
+        git_tree_free(theirs);
+        git_tree_free(ancestor);
+        git_commit_free(parent);
+        git_commit_free(commit);
+        index = NULL;
+        ours = theirs = ancestor = NULL;
+        parent = commit = NULL;
     }
+    if (PyErr_Occurred())
+        goto release;
 
-    err = git_commit_create(&oid, self->repo, update_ref,
-                            py_author->signature, py_committer->signature,
-                            encoding, message, tree, parent_count,
-                            (const git_commit**)parents);
-    if (err < 0) {
-        Error_set(err);
-        goto out;
+    /* The commits replayed before a conflict are kept. Inside a
+     * pack_writer() block, they are left to that PackWriter */
+    if (!pgit_packwriter_shared(backend)) {
+        err = pgit_packwriter_write(backend, self->repo);
+        if (err < 0) {
+            Error_set(err);
+            goto release;
+        }
     }
 
-    py_result = git_oid_to_python(&oid);
+    if (update_ref && py_stopped == NULL && PyList_GET_SIZE(oids) > 0) {
+        PyOS_snprintf(log_message, sizeof(log_message),
+                      "replay: %zd commits", PyList_GET_SIZE(oids));
+        err = Repository_update_ref_to(self->repo, update_ref, &head_id,
+                                       log_message);
+        if (err < 0) {
+            Error_set(err);
+            goto release;
+        }
+    }
 
-out:
-    Py_DECREF(tmessage);
-    git_tree_free(tree);
-    while (i > 0) {
-        i--;
-        git_commit_free(parents[i]);
+    if (py_stopped == NULL) {
+        py_stopped = Py_None;
+        Py_INCREF(py_stopped);
     }
-    free(parents);
+    py_result = Py_BuildValue("ONOO", oids, git_oid_to_python(&tree_id),
+                              py_stopped, py_paths);
+
+release:
+    pgit_packwriter_release(backend);
+
+cleanup:
+    git_index_free(index);
+    git_tree_free(ours);
+    git_tree_free(theirs);
+    git_tree_free(ancestor);
+    git_commit_free(parent);
+    git_commit_free(commit);
+    Py_XDECREF(py_stopped);
+    Py_XDECREF(py_paths);
+    Py_XDECREF(oids);
+    Py_DECREF(iter);
     return py_result;
 }
 
 
+PyDoc_STRVAR(Repository__write_archive__doc__,
+  "_write_archive(treeish, output, format, prefix, timestamp, level)\n"
+  "\n"
+  "Write the tree of treeish to the writable output as a tar (format 0),\n"
+  "gzipped tar (1) or zip (2) archive, in chunks.");
+
+PyObject *
+Repository__write_archive(Repository *self, PyObject *args)
+{
+    PyObject *py_treeish, *output;
+    const char *prefix;
+    long long timestamp;
+    int format, level, err;
+    git_tree *tree;
+
+    if (!PyArg_ParseTuple(args, "OOisLi", &py_treeish, &output, &format,
+                          &prefix, &timestamp, &level))
+        return NULL;
+
+    if (format < PGIT_ARCHIVE_TAR || format > PGIT_ARCHIVE_ZIP) {
+        PyErr_SetString(PyExc_ValueError, "unknown archive format");
+        return NULL;
+    }
+
+    if (Repository_peel_tree(&tree, self->repo, py_treeish) < 0)
+        return NULL;
+
+    err = pgit_archive_write(self->repo, tree, format, output, prefix,
+                             (git_time_t)timestamp, level);
+    git_tree_free(tree);
+    if (err < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
 PyDoc_STRVAR(Repository_create_tag__doc__,
   "create_tag(name, oid, type, tagger, message) -> Oid\n"
   "\n"
@@ -1437,46 +2269,164 @@ Repository_compress_references(Repository *self)
     Py_RETURN_NONE;
 }
 
+static char *status_kwlist[] = {"paths", "show", "untracked_files", "ignored",
+                                 "renames", "no_refresh", "flags", NULL};
+
+/*
+ * Fill the git_status_options from the keyword arguments shared by status(),
+ * status_iter() and is_dirty(). On success the pathspec must be released
+ * with free_strarraygit().
+ */
+static int
+status_options_from_args(git_status_options *opts, PyObject *py_paths,
+                         unsigned int show, const char *untracked_files,
+                         int ignored, int renames, int no_refresh,
+                         unsigned int flags)
+{
+    opts->show = show;
+    opts->flags = flags;
+
+    if (strcmp(untracked_files, "all") == 0)
+        opts->flags |= GIT_STATUS_OPT_INCLUDE_UNTRACKED |
+                       GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS;
+    else if (strcmp(untracked_files, "normal") == 0)
+        opts->flags |= GIT_STATUS_OPT_INCLUDE_UNTRACKED;
+    else if (strcmp(untracked_files, "no") != 0) {
+        PyErr_Format(PyExc_ValueError,
+                     "untracked_files must be 'all', 'normal' or 'no', not '%s'",
+                     untracked_files);
+        return -1;
+    }
+
+    if (ignored)
+        opts->flags |= GIT_STATUS_OPT_INCLUDE_IGNORED;
+
+    if (renames)
+        opts->flags |= GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX |
+                       GIT_STATUS_OPT_RENAMES_INDEX_TO_WORKDIR;
+
+    if (no_refresh)
+        opts->flags |= GIT_STATUS_OPT_NO_REFRESH;
+
+    if (py_paths != NULL && py_paths != Py_None)
+        return get_strarraygit_from_pylist(&opts->pathspec, py_paths);
+
+    return 0;
+}
+
+static git_status_list *
+status_list_from_args(Repository *self, PyObject *args, PyObject *kw,
+                      const char *untracked_files, int ignored)
+{
+    git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+    git_status_list *list;
+    const char *default_untracked_files = untracked_files;
+    PyObject *py_paths = NULL;
+    unsigned int show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+    unsigned int flags = 0;
+    int renames = 0, no_refresh = 0;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|OIzpppI", status_kwlist,
+                                     &py_paths, &show, &untracked_files,
+                                     &ignored, &renames, &no_refresh, &flags))
+        return NULL;
+
+    /* An explicit None means the default of the method */
+    if (untracked_files == NULL)
+        untracked_files = default_untracked_files;
+
+    if (status_options_from_args(&opts, py_paths, show, untracked_files,
+                                 ignored, renames, no_refresh, flags) < 0)
+        return NULL;
+
+    err = git_status_list_new(&list, self->repo, &opts);
+    free_strarraygit(&opts.pathspec);
+    if (err < 0) {
+        Error_set(err);
+        return NULL;
+    }
+
+    return list;
+}
+
+static const char *
+status_entry_path(const git_status_entry *entry)
+{
+    /* We need to choose one of the strings */
+    if (entry->head_to_index)
+        return entry->head_to_index->old_file.path;
+
+    return entry->index_to_workdir->old_file.path;
+}
+
+#define STATUS_OPTIONS_DOC \
+  "Parameters:\n" \
+  "\n" \
+  "paths\n" \
+  "    A sequence of pathspecs restricting the paths to look at.\n" \
+  "\n" \
+  "show\n" \
+  "    One of GIT_STATUS_SHOW_INDEX_AND_WORKDIR (the default),\n" \
+  "    GIT_STATUS_SHOW_INDEX_ONLY or GIT_STATUS_SHOW_WORKDIR_ONLY.\n" \
+  "\n" \
+  "untracked_files\n" \
+  "    'all' to list every untracked file, 'normal' to only list untracked\n" \
+  "    directories without recursing into them, 'no' to skip the scan for\n" \
+  "    untracked files altogether. None, like omitting it, selects the\n" \
+  "    default of the method.\n" \
+  "\n" \
+  "ignored\n" \
+  "    Whether to include ignored files.\n" \
+  "\n" \
+  "renames\n" \
+  "    Whether to run rename detection, both between HEAD and the index and\n" \
+  "    between the index and the working directory.\n" \
+  "\n" \
+  "no_refresh\n" \
+  "    Do not refresh the index from disk, nor update its stat cache.\n" \
+  "\n" \
+  "flags\n" \
+  "    Extra GIT_STATUS_OPT_* flags.\n"
+
 PyDoc_STRVAR(Repository_status__doc__,
-  "status() -> {str: int}\n"
+  "status(paths=None, show=GIT_STATUS_SHOW_INDEX_AND_WORKDIR,\n"
+  "       untracked_files='all', ignored=True, renames=False,\n"
+  "       no_refresh=False, flags=0) -> {str: int}\n"
   "\n"
   "Reads the status of the repository and returns a dictionary with file\n"
-  "paths as keys and status flags as values. See pygit2.GIT_STATUS_*.");
+  "paths as keys and status flags as values. See pygit2.GIT_STATUS_*.\n"
+  "\n"
+  STATUS_OPTIONS_DOC);
 
 PyObject *
-Repository_status(Repository *self)
+Repository_status(Repository *self, PyObject *args, PyObject *kw)
 {
     PyObject *dict;
     int err;
     size_t len, i;
     git_status_list *list;
 
-    dict = PyDict_New();
-    if (dict == NULL)
+    list = status_list_from_args(self, args, kw, "all", 1);
+    if (list == NULL)
         return NULL;
 
-    err = git_status_list_new(&list, self->repo, NULL);
-    if (err < 0)
-        return Error_set(err);
+    dict = PyDict_New();
+    if (dict == NULL)
+        goto error;
 
     len = git_status_list_entrycount(list);
     for (i = 0; i < len; i++) {
         const git_status_entry *entry;
-        const char *path;
         PyObject *status;
 
         entry = git_status_byindex(list, i);
         if (entry == NULL)
             goto error;
 
-        /* We need to choose one of the strings */
-        if (entry->head_to_index)
-            path = entry->head_to_index->old_file.path;
-        else
-            path = entry->index_to_workdir->old_file.path;
         status = PyLong_FromLong((long) entry->status);
 
-        err = PyDict_SetItemString(dict, path, status);
+        err = PyDict_SetItemString(dict, status_entry_path(entry), status);
         Py_CLEAR(status);
 
         if (err < 0)
@@ -1494,6 +2444,69 @@ error:
 }
 
 
+PyDoc_STRVAR(Repository_status_iter__doc__,
+  "status_iter(paths=None, show=GIT_STATUS_SHOW_INDEX_AND_WORKDIR,\n"
+  "            untracked_files='all', ignored=True, renames=False,\n"
+  "            no_refresh=False, flags=0) -> iterator\n"
+  "\n"
+  "Like status(), but returns an iterator of (path, flags) tuples instead\n"
+  "of building a dictionary.\n"
+  "\n"
+  STATUS_OPTIONS_DOC);
+
+PyObject *
+Repository_status_iter(Repository *self, PyObject *args, PyObject *kw)
+{
+    StatusIter *iter;
+    git_status_list *list;
+
+    list = status_list_from_args(self, args, kw, "all", 1);
+    if (list == NULL)
+        return NULL;
+
+    iter = PyObject_New(StatusIter, &StatusIterType);
+    if (iter == NULL) {
+        git_status_list_free(list);
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    iter->repo = self;
+    iter->list = list;
+    iter->i = 0;
+    iter->n = git_status_list_entrycount(list);
+    return (PyObject*)iter;
+}
+
+
+PyDoc_STRVAR(Repository_is_dirty__doc__,
+  "is_dirty(paths=None, show=GIT_STATUS_SHOW_INDEX_AND_WORKDIR,\n"
+  "         untracked_files='normal', ignored=False, renames=False,\n"
+  "         no_refresh=False, flags=0) -> bool\n"
+  "\n"
+  "Returns True if the status of the repository has at least one entry.\n"
+  "No Python object is built for the entries, and by default ignored files\n"
+  "are skipped and untracked directories are not recursed into.\n"
+  "\n"
+  STATUS_OPTIONS_DOC);
+
+PyObject *
+Repository_is_dirty(Repository *self, PyObject *args, PyObject *kw)
+{
+    git_status_list *list;
+    size_t len;
+
+    list = status_list_from_args(self, args, kw, "normal", 0);
+    if (list == NULL)
+        return NULL;
+
+    len = git_status_list_entrycount(list);
+    git_status_list_free(list);
+
+    return PyBool_FromLong(len > 0);
+}
+
+
 PyDoc_STRVAR(Repository_status_file__doc__,
   "status_file(path) -> int\n"
   "\n"
@@ -1570,12 +2583,173 @@ Repository_TreeBuilder(Repository *self, PyObject *args)
     if (builder) {
         builder->repo = self;
         builder->bld = bld;
+        builder->unchecked = NULL;
         Py_INCREF(self);
     }
 
     return (PyObject*)builder;
 }
 
+PyDoc_STRVAR(Repository_CommitTemplate__doc__,
+  "CommitTemplate(author, committer=None, encoding=None) -> CommitTemplate\n"
+  "\n"
+  "Create a CommitTemplate object for this repository, to create many\n"
+  "commits with the given author, committer (the author by default) and\n"
+  "message encoding.");
+
+PyObject *
+Repository_CommitTemplate(Repository *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"author", "committer", "encoding", NULL};
+    CommitTemplate *template;
+    Signature *py_author, *py_committer = NULL;
+    git_signature *author = NULL, *committer = NULL;
+    char *encoding = NULL;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|Oz", kwlist,
+                                     &SignatureType, &py_author,
+                                     &py_committer,
+                                     &encoding))
+        return NULL;
+
+    if (py_committer == NULL || (PyObject*)py_committer == Py_None) {
+        py_committer = py_author;
+    } else if (!PyObject_TypeCheck(py_committer, &SignatureType)) {
+        PyErr_SetString(PyExc_TypeError, "committer must be a Signature");
+        return NULL;
+    }
+
+    /* Own copies, their time is changed by CommitTemplate.create() */
+    err = git_signature_dup(&author, py_author->signature);
+    if (err == 0)
+        err = git_signature_dup(&committer, py_committer->signature);
+    if (err < 0) {
+        Error_set(err);
+        goto error;
+    }
+
+    template = PyObject_New(CommitTemplate, &CommitTemplateType);
+    if (template == NULL)
+        goto error;
+
+    template->encoding = NULL;
+    if (encoding) {
+        template->encoding = strdup(encoding);
+        if (template->encoding == NULL) {
+            PyObject_Del(template);
+            PyErr_NoMemory();
+            goto error;
+        }
+    }
+
+    template->repo = self;
+    template->author = author;
+    template->committer = committer;
+    template->parent_ids = NULL;
+    template->parent_ptrs = NULL;
+    template->alloc = 0;
+    Py_INCREF(self);
+    return (PyObject*)template;
+
+error:
+    git_signature_free(author);
+    git_signature_free(committer);
+    return NULL;
+}
+
+
+PyDoc_STRVAR(Repository_pack_writer__doc__,
+  "pack_writer() -> PackWriter\n"
+  "\n"
+  "Route every object written to this repository into a single new pack,\n"
+  "instead of one loose object each, until the returned PackWriter is\n"
+  "closed. Meant to be used as a context manager:\n"
+  "\n"
+  "    with repo.pack_writer():\n"
+  "        ...\n"
+  "\n"
+  "The objects are kept in memory, and can be read, until the pack and its\n"
+  "index are written on exit. This happens even if the block raises, since\n"
+  "references updated inside it may already point to those objects.");
+
+PyObject *
+Repository_pack_writer(Repository *self)
+{
+    PackWriter *writer;
+    git_odb_backend *backend;
+    int err;
+
+    err = pgit_packwriter_acquire(&backend, self);
+    if (err < 0)
+        return Error_set(err);
+
+    writer = PyObject_New(PackWriter, &PackWriterType);
+    if (writer == NULL) {
+        pgit_packwriter_release(backend);
+        return NULL;
+    }
+
+    writer->repo = self;
+    writer->backend = backend;
+    Py_INCREF(self);
+    return (PyObject*)writer;
+}
+
+
+PyDoc_STRVAR(Repository_TreeEditor__doc__,
+  "TreeEditor([tree]) -> TreeEditor\n"
+  "\n"
+  "Create a TreeEditor object for this repository, to change the given\n"
+  "tree (or an empty one) by full paths.");
+
+PyObject *
+Repository_TreeEditor(Repository *self, PyObject *args)
+{
+    TreeEditor *editor;
+    PyObject *py_src = NULL;
+    git_oid oid;
+    git_tree *tree = NULL;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "|O", &py_src))
+        return NULL;
+
+    if (py_src) {
+        if (PyObject_TypeCheck(py_src, &TreeType)) {
+            Tree *py_tree = (Tree *)py_src;
+            if (py_tree->repo->repo != self->repo) {
+                PyErr_SetString(PyExc_TypeError,
+                                "tree must belong to this repository");
+                return NULL;
+            }
+            git_oid_cpy(&oid, Object__id((Object*)py_tree));
+        } else {
+            err = py_oid_to_git_oid_expand(self->repo, py_src, &oid);
+            if (err < 0)
+                return NULL;
+        }
+
+        err = git_tree_lookup(&tree, self->repo, &oid);
+        if (err < 0)
+            return Error_set(err);
+    }
+
+    editor = PyObject_New(TreeEditor, &TreeEditorType);
+    if (editor == NULL) {
+        git_tree_free(tree);
+        return NULL;
+    }
+
+    editor->repo = self;
+    editor->tree = tree;
+    editor->updates = NULL;
+    editor->n = 0;
+    editor->alloc = 0;
+    Py_INCREF(self);
+    return (PyObject*)editor;
+}
+
 PyDoc_STRVAR(Repository_default_signature__doc__, "Return the signature according to the repository's configuration");
 
 PyObject *
@@ -1939,19 +3113,86 @@ Repository_set_refdb(Repository *self, Refdb *refdb)
     Py_RETURN_NONE;
 }
 
+PyObject *
+StatusIter_iternext(StatusIter *self)
+{
+    const git_status_entry *entry;
+
+    if (self->i >= self->n)
+        return NULL;
+
+    entry = git_status_byindex(self->list, self->i++);
+    if (entry == NULL)
+        return NULL;
+
+    return Py_BuildValue("(NI)", to_path(status_entry_path(entry)),
+                         (unsigned int) entry->status);
+}
+
+void
+StatusIter_dealloc(StatusIter *self)
+{
+    Py_CLEAR(self->repo);
+    git_status_list_free(self->list);
+    PyObject_Del(self);
+}
+
+
+PyDoc_STRVAR(StatusIter__doc__, "Status iterator object.");
+
+PyTypeObject StatusIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.StatusIter",                      /* tp_name           */
+    sizeof(StatusIter),                        /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)StatusIter_dealloc,            /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    0,                                         /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT,                        /* tp_flags          */
+    StatusIter__doc__,                         /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    PyObject_SelfIter,                         /* tp_iter           */
+    (iternextfunc) StatusIter_iternext,        /* tp_iternext       */
+};
+
+
 PyMethodDef Repository_methods[] = {
     METHOD(Repository, create_blob, METH_VARARGS),
     METHOD(Repository, create_blob_fromworkdir, METH_VARARGS),
     METHOD(Repository, create_blob_fromdisk, METH_VARARGS),
     METHOD(Repository, create_blob_fromiobase, METH_O),
     METHOD(Repository, create_commit, METH_VARARGS),
+    METHOD(Repository, create_commit_from_ids, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, create_commit_buffer, METH_VARARGS),
+    METHOD(Repository, create_commits, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, _replay_commits, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, _write_archive, METH_VARARGS),
     METHOD(Repository, create_tag, METH_VARARGS),
     METHOD(Repository, TreeBuilder, METH_VARARGS),
+    METHOD(Repository, TreeEditor, METH_VARARGS),
+    METHOD(Repository, pack_writer, METH_NOARGS),
+    METHOD(Repository, CommitTemplate, METH_VARARGS | METH_KEYWORDS),
     METHOD(Repository, walk, METH_VARARGS),
     METHOD(Repository, descendant_of, METH_VARARGS),
     METHOD(Repository, merge_base, METH_VARARGS),
     METHOD(Repository, merge_analysis, METH_VARARGS),
     METHOD(Repository, merge, METH_O),
+    METHOD(Repository, _merge_check, METH_VARARGS),
     METHOD(Repository, cherrypick, METH_O),
     METHOD(Repository, apply, METH_O),
     METHOD(Repository, create_reference_direct, METH_VARARGS),
@@ -1964,7 +3205,9 @@ PyMethodDef Repository_methods[] = {
     METHOD(Repository, lookup_reference, METH_O),
     METHOD(Repository, lookup_reference_dwim, METH_O),
     METHOD(Repository, revparse_single, METH_O),
-    METHOD(Repository, status, METH_NOARGS),
+    METHOD(Repository, status, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, status_iter, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, is_dirty, METH_VARARGS | METH_KEYWORDS),
     METHOD(Repository, status_file, METH_O),
     METHOD(Repository, notes, METH_VARARGS),
     METHOD(Repository, create_note, METH_VARARGS),
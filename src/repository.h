@@ -49,6 +49,11 @@ PyObject* Repository_walk(Repository *self, PyObject *args);
 PyObject* Repository_create_blob(Repository *self, PyObject *args);
 PyObject* Repository_create_blob_fromfile(Repository *self, PyObject *args);
 PyObject* Repository_create_commit(Repository *self, PyObject *args);
+PyObject* Repository_create_commit_from_ids(Repository *self, PyObject *args, PyObject *kwds);
+PyObject* Repository_create_commit_buffer(Repository *self, PyObject *args);
+PyObject* Repository_create_commits(Repository *self, PyObject *args, PyObject *kwds);
+PyObject* Repository__replay_commits(Repository *self, PyObject *args, PyObject *kwds);
+PyObject* Repository__write_archive(Repository *self, PyObject *args);
 PyObject* Repository_create_tag(Repository *self, PyObject *args);
 PyObject* Repository_create_branch(Repository *self, PyObject *args);
 PyObject* Repository_listall_references(Repository *self, PyObject *args);
@@ -64,9 +69,14 @@ PyObject*
 Repository_create_reference(Repository *self, PyObject *args, PyObject* kw);
 
 PyObject* Repository_packall_references(Repository *self,  PyObject *args);
-PyObject* Repository_status(Repository *self);
+PyObject* Repository_status(Repository *self, PyObject *args, PyObject *kw);
+PyObject* Repository_status_iter(Repository *self, PyObject *args, PyObject *kw);
+PyObject* Repository_is_dirty(Repository *self, PyObject *args, PyObject *kw);
 PyObject* Repository_status_file(Repository *self, PyObject *value);
 PyObject* Repository_TreeBuilder(Repository *self, PyObject *args);
+PyObject* Repository_TreeEditor(Repository *self, PyObject *args);
+PyObject* Repository_pack_writer(Repository *self);
+PyObject* Repository_CommitTemplate(Repository *self, PyObject *args, PyObject *kwds);
 
 PyObject* Repository_blame(Repository *self, PyObject *args, PyObject *kwds);
 
@@ -74,5 +84,6 @@ PyObject* Repository_merge(Repository *self, PyObject *py_oid);
 PyObject* Repository_cherrypick(Repository *self, PyObject *py_oid);
 PyObject* Repository_apply(Repository *self, PyObject *py_diff);
 PyObject* Repository_merge_analysis(Repository *self, PyObject *args);
+PyObject* Repository__merge_check(Repository *self, PyObject *args);
 
 #endif
@@ -30,19 +30,122 @@
 #include <string.h>
 #include "error.h"
 #include "utils.h"
+#include "object.h"
 #include "oid.h"
 #include "treebuilder.h"
 #include "tree.h"
 
 
+/*
+ * The entries inserted by insert_many(validate=False) are not given to the
+ * git_treebuilder, which checks that their objects exist when
+ * GIT_OPT_ENABLE_STRICT_OBJECT_CREATION is enabled. They are kept in the
+ * 'unchecked' dict instead, and write() then serialises the tree itself,
+ * like pgit_commit_create_from_ids does for commits.
+ */
+
+typedef struct {
+    const char *name;
+    size_t len;
+    const git_oid *oid;
+    int attr;
+} treebuilder_entry;
+
+typedef struct {
+    treebuilder_entry *entries;
+    size_t n;
+} treebuilder_entries;
+
+
 void
 TreeBuilder_dealloc(TreeBuilder *self)
 {
     Py_CLEAR(self->repo);
+    Py_CLEAR(self->unchecked);
     git_treebuilder_free(self->bld);
     PyObject_Del(self);
 }
 
+/*
+ * Remove the unchecked entry of the given name. Return 1 if there was one,
+ * 0 if not, -1 on error.
+ */
+static int
+treebuilder_forget(TreeBuilder *self, const char *name)
+{
+    PyObject *key;
+    int found;
+
+    if (self->unchecked == NULL || PyDict_GET_SIZE(self->unchecked) == 0)
+        return 0;
+
+    key = PyBytes_FromString(name);
+    if (key == NULL)
+        return -1;
+
+    found = PyDict_Contains(self->unchecked, key);
+    if (found == 1 && PyDict_DelItem(self->unchecked, key) < 0)
+        found = -1;
+
+    Py_DECREF(key);
+    return found;
+}
+
+/*
+ * The checks git_treebuilder_insert does, but for the existence of the
+ * object.
+ */
+static int
+treebuilder_insert_unchecked(TreeBuilder *self, const char *name,
+                             const git_oid *oid, int attr)
+{
+    PyObject *key, *value;
+    int err;
+
+    if (*name == '\0' || strchr(name, '/') != NULL ||
+        strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+        PyOS_stricmp(name, ".git") == 0) {
+        PyErr_Format(PyExc_ValueError, "invalid name for a tree entry: '%s'",
+                     name);
+        return -1;
+    }
+
+    if (attr != GIT_FILEMODE_TREE && attr != GIT_FILEMODE_BLOB &&
+        attr != GIT_FILEMODE_BLOB_EXECUTABLE && attr != GIT_FILEMODE_LINK &&
+        attr != GIT_FILEMODE_COMMIT) {
+        PyErr_Format(PyExc_ValueError, "invalid filemode %o for '%s'", attr,
+                     name);
+        return -1;
+    }
+
+    if (git_oid_iszero(oid)) {
+        PyErr_Format(PyExc_ValueError, "null oid for '%s'", name);
+        return -1;
+    }
+
+    if (git_treebuilder_get(self->bld, name) != NULL) {
+        err = git_treebuilder_remove(self->bld, name);
+        if (err < 0) {
+            Error_set(err);
+            return -1;
+        }
+    }
+
+    if (self->unchecked == NULL) {
+        self->unchecked = PyDict_New();
+        if (self->unchecked == NULL)
+            return -1;
+    }
+
+    key = PyBytes_FromString(name);
+    value = Py_BuildValue("(y#i)", (const char *) oid->id,
+                          (Py_ssize_t) GIT_OID_RAWSZ, attr);
+    err = (key && value) ? PyDict_SetItem(self->unchecked, key, value) : -1;
+    Py_XDECREF(key);
+    Py_XDECREF(value);
+    return err;
+}
+
 
 PyDoc_STRVAR(TreeBuilder_insert__doc__,
     "insert(name, oid, attr)\n"
@@ -76,21 +179,242 @@ TreeBuilder_insert(TreeBuilder *self, PyObject *args)
     if (err < 0)
         return Error_set(err);
 
+    if (treebuilder_forget(self, fname) < 0)
+        return NULL;
+
     Py_RETURN_NONE;
 }
 
 
+PyDoc_STRVAR(TreeBuilder_insert_many__doc__,
+    "insert_many(names, oids, attrs, validate=True)\n"
+    "\n"
+    "Insert or replace many entries in the treebuilder at once.\n"
+    "\n"
+    "Parameters:\n"
+    "\n"
+    "names\n"
+    "    Sequence of entry names.\n"
+    "\n"
+    "oids\n"
+    "    Sequence of Oid objects or hex strings, or a bytes object with the\n"
+    "    20 bytes raw ids packed one after the other.\n"
+    "\n"
+    "attrs\n"
+    "    Sequence of GIT_FILEMODE_* values, or a single one for all the\n"
+    "    entries.\n"
+    "\n"
+    "validate\n"
+    "    If False, do not check that the objects exist, even with\n"
+    "    GIT_OPT_ENABLE_STRICT_OBJECT_CREATION enabled; the caller\n"
+    "    guarantees it. The names, modes and ids are still checked.\n");
+
+PyObject *
+TreeBuilder_insert_many(TreeBuilder *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"names", "oids", "attrs", "validate", NULL};
+    PyObject *py_names, *py_oids, *py_attrs;
+    PyObject *names = NULL, *oids = NULL, *attrs = NULL;
+    PyObject *result = NULL;
+    const char *raw = NULL, *name;
+    Py_ssize_t i, n, length;
+    int validate = 1, attr = 0, err;
+    git_oid oid;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO|p", kwlist,
+                                     &py_names, &py_oids, &py_attrs, &validate))
+        return NULL;
+
+    names = PySequence_Fast(py_names, "names must be a sequence");
+    if (names == NULL)
+        return NULL;
+    n = PySequence_Fast_GET_SIZE(names);
+
+    if (PyBytes_Check(py_oids)) {
+        if (PyBytes_AsStringAndSize(py_oids, (char **)&raw, &length))
+            goto cleanup;
+        if (length != n * GIT_OID_RAWSZ) {
+            PyErr_Format(PyExc_ValueError, "expected %zd packed oids", n);
+            goto cleanup;
+        }
+    } else {
+        oids = PySequence_Fast(py_oids, "oids must be a sequence or bytes");
+        if (oids == NULL)
+            goto cleanup;
+        if (PySequence_Fast_GET_SIZE(oids) != n) {
+            PyErr_Format(PyExc_ValueError, "expected %zd oids", n);
+            goto cleanup;
+        }
+    }
+
+    if (PyLong_Check(py_attrs)) {
+        attr = (int) PyLong_AsLong(py_attrs);
+        if (attr == -1 && PyErr_Occurred())
+            goto cleanup;
+    } else {
+        attrs = PySequence_Fast(py_attrs, "attrs must be a sequence or an int");
+        if (attrs == NULL)
+            goto cleanup;
+        if (PySequence_Fast_GET_SIZE(attrs) != n) {
+            PyErr_Format(PyExc_ValueError, "expected %zd attrs", n);
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        name = pgit_borrow(PySequence_Fast_GET_ITEM(names, i));
+        if (name == NULL)
+            goto cleanup;
+
+        if (raw) {
+            git_oid_fromraw(&oid, (const unsigned char *) raw + i * GIT_OID_RAWSZ);
+        } else if (py_oid_to_git_oid(PySequence_Fast_GET_ITEM(oids, i), &oid) == 0) {
+            goto cleanup;
+        }
+
+        if (attrs) {
+            attr = (int) PyLong_AsLong(PySequence_Fast_GET_ITEM(attrs, i));
+            if (attr == -1 && PyErr_Occurred())
+                goto cleanup;
+        }
+
+        if (!validate) {
+            if (treebuilder_insert_unchecked(self, name, &oid, attr) < 0)
+                goto cleanup;
+            continue;
+        }
+
+        err = git_treebuilder_insert(NULL, self->bld, name, &oid, attr);
+        if (err < 0) {
+            Error_set(err);
+            goto cleanup;
+        }
+
+        if (treebuilder_forget(self, name) < 0)
+            goto cleanup;
+    }
+
+    Py_INCREF(Py_None);
+    result = Py_None;
+
+cleanup:
+    Py_XDECREF(names);
+    Py_XDECREF(oids);
+    Py_XDECREF(attrs);
+    return result;
+}
+
+
 PyDoc_STRVAR(TreeBuilder_write__doc__,
     "write() -> Oid\n"
     "\n"
     "Write the tree to the given repository.");
 
+static int
+treebuilder_collect(const git_tree_entry *entry, void *payload)
+{
+    treebuilder_entries *list = payload;
+    treebuilder_entry *e = &list->entries[list->n++];
+
+    e->name = git_tree_entry_name(entry);
+    e->len = strlen(e->name);
+    e->oid = git_tree_entry_id(entry);
+    e->attr = git_tree_entry_filemode(entry);
+    return 0; /* Keep the entry */
+}
+
+/* Git's order: the name of a tree sorts as if it ended with a slash */
+static int
+treebuilder_entry_cmp(const void *a, const void *b)
+{
+    const treebuilder_entry *e1 = a, *e2 = b;
+    size_t len = e1->len < e2->len ? e1->len : e2->len;
+    unsigned char c1, c2;
+    int cmp;
+
+    cmp = memcmp(e1->name, e2->name, len);
+    if (cmp)
+        return cmp;
+
+    c1 = len < e1->len ? e1->name[len] : (e1->attr == GIT_FILEMODE_TREE ? '/' : 0);
+    c2 = len < e2->len ? e2->name[len] : (e2->attr == GIT_FILEMODE_TREE ? '/' : 0);
+    return c1 - c2;
+}
+
+static PyObject *
+treebuilder_write_unchecked(TreeBuilder *self)
+{
+    treebuilder_entries list;
+    treebuilder_entry *e;
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    git_odb *odb = NULL;
+    char *buf, *p;
+    size_t i, size = 0;
+    git_oid oid;
+    int err;
+
+    list.n = 0;
+    list.entries = malloc(sizeof(treebuilder_entry) *
+                          (git_treebuilder_entrycount(self->bld) +
+                           PyDict_GET_SIZE(self->unchecked) + 1));
+    if (list.entries == NULL)
+        return PyErr_NoMemory();
+
+    git_treebuilder_filter(self->bld, treebuilder_collect, &list);
+    while (PyDict_Next(self->unchecked, &pos, &key, &value)) {
+        e = &list.entries[list.n++];
+        e->name = PyBytes_AS_STRING(key);
+        e->len = PyBytes_GET_SIZE(key);
+        e->oid = (const git_oid *) PyBytes_AS_STRING(PyTuple_GET_ITEM(value, 0));
+        e->attr = (int) PyLong_AsLong(PyTuple_GET_ITEM(value, 1));
+    }
+
+    qsort(list.entries, list.n, sizeof(treebuilder_entry),
+          treebuilder_entry_cmp);
+
+    /* "<octal mode> <name>\0<raw id>", the mode is at most 6 digits */
+    for (i = 0; i < list.n; i++)
+        size += 7 + list.entries[i].len + 1 + GIT_OID_RAWSZ;
+
+    buf = malloc(size + 1);
+    if (buf == NULL) {
+        free(list.entries);
+        return PyErr_NoMemory();
+    }
+
+    p = buf;
+    for (i = 0; i < list.n; i++) {
+        e = &list.entries[i];
+        p += sprintf(p, "%o ", e->attr);
+        memcpy(p, e->name, e->len + 1);
+        p += e->len + 1;
+        memcpy(p, e->oid->id, GIT_OID_RAWSZ);
+        p += GIT_OID_RAWSZ;
+    }
+
+    err = git_repository_odb(&odb, self->repo->repo);
+    if (err == 0)
+        err = git_odb_write(&oid, odb, buf, p - buf, GIT_OBJ_TREE);
+    git_odb_free(odb);
+    free(buf);
+    free(list.entries);
+
+    if (err < 0)
+        return Error_set(err);
+
+    return git_oid_to_python(&oid);
+}
+
 PyObject *
 TreeBuilder_write(TreeBuilder *self)
 {
     int err;
     git_oid oid;
 
+    if (self->unchecked != NULL && PyDict_GET_SIZE(self->unchecked) > 0)
+        return treebuilder_write_unchecked(self);
+
     err = git_treebuilder_write(&oid, self->bld);
     if (err < 0)
         return Error_set(err);
@@ -104,13 +428,50 @@ PyDoc_STRVAR(TreeBuilder_get__doc__,
     "\n"
     "Return the Object for the given name, or None if there is not.");
 
+static PyObject *
+treebuilder_get_unchecked(TreeBuilder *self, const char *filename)
+{
+    PyObject *key, *value;
+    git_object *obj;
+    git_oid oid;
+    int err;
+
+    if (self->unchecked == NULL || PyDict_GET_SIZE(self->unchecked) == 0)
+        return NULL;
+
+    key = PyBytes_FromString(filename);
+    if (key == NULL)
+        return NULL;
+
+    value = PyDict_GetItemWithError(self->unchecked, key);
+    Py_DECREF(key);
+    if (value == NULL)
+        return NULL;
+
+    /* There is no git_tree_entry, look the object up */
+    git_oid_fromraw(&oid, (const unsigned char *)
+                    PyBytes_AS_STRING(PyTuple_GET_ITEM(value, 0)));
+    err = git_object_lookup(&obj, self->repo->repo, &oid, GIT_OBJ_ANY);
+    if (err < 0)
+        return Error_set(err);
+
+    return wrap_object(obj, self->repo, NULL);
+}
+
 PyObject *
 TreeBuilder_get(TreeBuilder *self, PyObject *py_filename)
 {
+    PyObject *py_obj;
     char *filename = pgit_encode_fsdefault(py_filename);
     if (filename == NULL)
         return NULL;
 
+    py_obj = treebuilder_get_unchecked(self, filename);
+    if (py_obj != NULL || PyErr_Occurred()) {
+        free(filename);
+        return py_obj;
+    }
+
     const git_tree_entry *entry_src = git_treebuilder_get(self->bld, filename);
     free(filename);
     if (entry_src == NULL)
@@ -138,6 +499,14 @@ TreeBuilder_remove(TreeBuilder *self, PyObject *py_filename)
     if (filename == NULL)
         return NULL;
 
+    int found = treebuilder_forget(self, filename);
+    if (found != 0) {
+        free(filename);
+        if (found < 0)
+            return NULL;
+        Py_RETURN_NONE;
+    }
+
     int err = git_treebuilder_remove(self->bld, filename);
     free(filename);
     if (err)
@@ -156,6 +525,8 @@ PyObject *
 TreeBuilder_clear(TreeBuilder *self)
 {
     git_treebuilder_clear(self->bld);
+    if (self->unchecked != NULL)
+        PyDict_Clear(self->unchecked);
     Py_RETURN_NONE;
 }
 
@@ -163,6 +534,7 @@ PyMethodDef TreeBuilder_methods[] = {
     METHOD(TreeBuilder, clear, METH_NOARGS),
     METHOD(TreeBuilder, get, METH_O),
     METHOD(TreeBuilder, insert, METH_VARARGS),
+    METHOD(TreeBuilder, insert_many, METH_VARARGS | METH_KEYWORDS),
     METHOD(TreeBuilder, remove, METH_O),
     METHOD(TreeBuilder, write, METH_NOARGS),
     {NULL}
@@ -172,7 +544,11 @@ PyMethodDef TreeBuilder_methods[] = {
 Py_ssize_t
 TreeBuilder_len(TreeBuilder *self)
 {
-    return (Py_ssize_t)git_treebuilder_entrycount(self->bld);
+    Py_ssize_t len = (Py_ssize_t)git_treebuilder_entrycount(self->bld);
+
+    if (self->unchecked != NULL)
+        len += PyDict_GET_SIZE(self->unchecked);
+    return len;
 }
 
 
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2010-2020 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "utils.h"
+#include "oid.h"
+#include "treeeditor.h"
+
+
+static void
+TreeEditor_free_updates(TreeEditor *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->n; i++)
+        free((char *) self->updates[i].path);
+    self->n = 0;
+}
+
+void
+TreeEditor_dealloc(TreeEditor *self)
+{
+    Py_CLEAR(self->repo);
+    git_tree_free(self->tree);
+    TreeEditor_free_updates(self);
+    free(self->updates);
+    PyObject_Del(self);
+}
+
+static int
+TreeEditor_append(TreeEditor *self, git_tree_update_t action, PyObject *py_path,
+                  const git_oid *oid, git_filemode_t attr)
+{
+    git_tree_update *update;
+    char *path;
+
+    if (self->n == self->alloc) {
+        size_t alloc = self->alloc ? self->alloc * 2 : 16;
+        update = realloc(self->updates, alloc * sizeof(git_tree_update));
+        if (update == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->updates = update;
+        self->alloc = alloc;
+    }
+
+    path = pgit_encode_fsdefault(py_path);
+    if (path == NULL)
+        return -1;
+
+    update = &self->updates[self->n++];
+    update->action = action;
+    update->path = path;
+    update->filemode = attr;
+    if (oid)
+        git_oid_cpy(&update->id, oid);
+    else
+        memset(&update->id, 0, sizeof(git_oid));
+
+    return 0;
+}
+
+
+PyDoc_STRVAR(TreeEditor_upsert__doc__,
+    "upsert(path, oid, attr)\n"
+    "\n"
+    "Insert or replace the entry at the given path, creating the missing\n"
+    "intermediate trees. The change is only applied by write().\n"
+    "\n"
+    "Parameters:\n"
+    "\n"
+    "attr\n"
+    "    Available values are GIT_FILEMODE_BLOB,\n"
+    "    GIT_FILEMODE_BLOB_EXECUTABLE, GIT_FILEMODE_TREE, GIT_FILEMODE_LINK\n"
+    "    and GIT_FILEMODE_COMMIT.\n");
+
+PyObject *
+TreeEditor_upsert(TreeEditor *self, PyObject *args)
+{
+    PyObject *py_path, *py_oid;
+    size_t len;
+    int attr;
+    git_oid oid;
+
+    if (!PyArg_ParseTuple(args, "OOi", &py_path, &py_oid, &attr))
+        return NULL;
+
+    len = py_oid_to_git_oid(py_oid, &oid);
+    if (len == 0)
+        return NULL;
+
+    if (TreeEditor_append(self, GIT_TREE_UPDATE_UPSERT, py_path, &oid, attr) < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(TreeEditor_remove__doc__,
+    "remove(path)\n"
+    "\n"
+    "Remove the entry at the given path. The change is only applied by\n"
+    "write(), which fails if there is no such entry.");
+
+PyObject *
+TreeEditor_remove(TreeEditor *self, PyObject *py_path)
+{
+    if (TreeEditor_append(self, GIT_TREE_UPDATE_REMOVE, py_path, NULL, 0) < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(TreeEditor_write__doc__,
+    "write() -> Oid\n"
+    "\n"
+    "Apply all the pending changes at once, and write the new trees to the\n"
+    "repository. Only the trees along the changed paths are loaded and\n"
+    "written. The written tree becomes the base of the next changes.");
+
+PyObject *
+TreeEditor_write(TreeEditor *self)
+{
+    int err;
+    git_oid oid;
+    git_tree *tree;
+
+    err = git_tree_create_updated(&oid, self->repo->repo, self->tree,
+                                  self->n, self->updates);
+    if (err < 0)
+        return Error_set(err);
+
+    err = git_tree_lookup(&tree, self->repo->repo, &oid);
+    if (err < 0)
+        return Error_set(err);
+
+    git_tree_free(self->tree);
+    self->tree = tree;
+    TreeEditor_free_updates(self);
+
+    return git_oid_to_python(&oid);
+}
+
+
+PyDoc_STRVAR(TreeEditor_clear__doc__,
+    "clear()\n"
+    "\n"
+    "Drop all the pending changes.");
+
+PyObject *
+TreeEditor_clear(TreeEditor *self)
+{
+    TreeEditor_free_updates(self);
+    Py_RETURN_NONE;
+}
+
+PyMethodDef TreeEditor_methods[] = {
+    METHOD(TreeEditor, clear, METH_NOARGS),
+    METHOD(TreeEditor, remove, METH_O),
+    METHOD(TreeEditor, upsert, METH_VARARGS),
+    METHOD(TreeEditor, write, METH_NOARGS),
+    {NULL}
+};
+
+
+Py_ssize_t
+TreeEditor_len(TreeEditor *self)
+{
+    return (Py_ssize_t)self->n;
+}
+
+
+PyMappingMethods TreeEditor_as_mapping = {
+    (lenfunc)TreeEditor_len,      /* mp_length */
+    0,                            /* mp_subscript */
+    0,                            /* mp_ass_subscript */
+};
+
+
+PyDoc_STRVAR(TreeEditor__doc__,
+    "TreeEditor objects, to change a tree by full paths. Their length is\n"
+    "the number of pending changes.");
+
+PyTypeObject TreeEditorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.TreeEditor",                      /* tp_name           */
+    sizeof(TreeEditor),                        /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)TreeEditor_dealloc,            /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    &TreeEditor_as_mapping,                    /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,  /* tp_flags          */
+    TreeEditor__doc__,                         /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    0,                                         /* tp_iter           */
+    0,                                         /* tp_iternext       */
+    TreeEditor_methods,                        /* tp_methods        */
+    0,                                         /* tp_members        */
+    0,                                         /* tp_getset         */
+    0,                                         /* tp_base           */
+    0,                                         /* tp_dict           */
+    0,                                         /* tp_descr_get      */
+    0,                                         /* tp_descr_set      */
+    0,                                         /* tp_dictoffset     */
+    0,                                         /* tp_init           */
+    0,                                         /* tp_alloc          */
+    0,                                         /* tp_new            */
+};
@@ -48,6 +48,7 @@ typedef struct {
     PyObject *index;  /* It will be None for a bare repository */
     PyObject *config; /* It will be None for a bare repository */
     int owned;    /* _from_c() sometimes means we don't own the C pointer */
+    git_odb_backend *packwriter; /* Attached on first use, owned by the odb */
 } Repository;
 
 
@@ -196,7 +197,41 @@ typedef struct {
 SIMPLE_TYPE(DiffStats, git_diff_stats, stats);
 
 /* git_tree_walk , git_treebuilder*/
-SIMPLE_TYPE(TreeBuilder, git_treebuilder, bld)
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_treebuilder *bld;
+    PyObject *unchecked;  /* name -> (raw oid, attr), not validated */
+} TreeBuilder;
+
+/* git_tree_create_updated */
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_tree *tree;
+    git_tree_update *updates;
+    size_t n;
+    size_t alloc;
+} TreeEditor;
+
+/* Repository.CommitTemplate() */
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_signature *author;
+    git_signature *committer;
+    char *encoding;
+    git_oid *parent_ids;
+    const git_oid **parent_ptrs;
+    size_t alloc;
+} CommitTemplate;
+
+/* Repository.pack_writer() */
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_odb_backend *backend; /* NULL once closed */
+} PackWriter;
 
 typedef struct {
     PyObject_HEAD
@@ -208,6 +243,15 @@ typedef struct {
 /* git_index */
 SIMPLE_TYPE(Index, git_index, index)
 
+/* git_status_list */
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_status_list *list;
+    size_t i;
+    size_t n;
+} StatusIter;
+
 typedef struct {
     PyObject_HEAD
     git_index_entry entry;
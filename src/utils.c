@@ -160,28 +160,34 @@ get_pylist_from_git_strarray(git_strarray *strarray)
 */
 
 /**
- * Converts the Python list to struct git_strarray
+ * Converts the Python sequence to struct git_strarray, a single str or bytes
+ * is rejected rather than split into characters
  * returns -1 if conversion failed
  */
-/*
 int
 get_strarraygit_from_pylist(git_strarray *array, PyObject *pylist)
 {
     Py_ssize_t index, n;
-    PyObject *item;
+    PyObject *seq, *item;
     void *ptr;
     char *str;
 
-    if (!PyList_Check(pylist)) {
-        PyErr_SetString(PyExc_TypeError, "Value must be a list");
+    if (PyUnicode_Check(pylist) || PyBytes_Check(pylist)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "Value must be a sequence of paths, not a string");
         return -1;
     }
 
-    n = PyList_Size(pylist);
+    seq = PySequence_Fast(pylist, "Value must be a sequence");
+    if (seq == NULL)
+        return -1;
+
+    n = PySequence_Fast_GET_SIZE(seq);
 
     // allocate new git_strarray
     ptr = calloc(n, sizeof(char *));
     if (!ptr) {
+        Py_DECREF(seq);
         PyErr_SetNone(PyExc_MemoryError);
         return -1;
     }
@@ -190,7 +196,7 @@ get_strarraygit_from_pylist(git_strarray *array, PyObject *pylist)
     array->count = n;
 
     for (index = 0; index < n; index++) {
-        item = PyList_GetItem(pylist, index);
+        item = PySequence_Fast_GET_ITEM(seq, index);
         str = pgit_encode(item, NULL);
         if (!str)
             goto on_error;
@@ -198,9 +204,11 @@ get_strarraygit_from_pylist(git_strarray *array, PyObject *pylist)
         array->strings[index] = str;
     }
 
+    Py_DECREF(seq);
     return 0;
 
 on_error:
+    Py_DECREF(seq);
     n = index;
     for (index = 0; index < n; index++) {
         free(array->strings[index]);
@@ -209,7 +217,22 @@ on_error:
 
     return -1;
 }
-*/
+
+/**
+ * Frees a git_strarray filled by get_strarraygit_from_pylist
+ */
+void
+free_strarraygit(git_strarray *array)
+{
+    size_t index;
+
+    for (index = 0; index < array->count; index++)
+        free(array->strings[index]);
+
+    free(array->strings);
+    array->strings = NULL;
+    array->count = 0;
+}
 
 static git_otype
 py_type_to_git_type(PyTypeObject *py_type)
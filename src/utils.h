@@ -91,7 +91,8 @@ char* pgit_encode_fsdefault(PyObject *value);
 
 
 //PyObject * get_pylist_from_git_strarray(git_strarray *strarray);
-//int get_strarraygit_from_pylist(git_strarray *array, PyObject *pylist);
+int get_strarraygit_from_pylist(git_strarray *array, PyObject *pylist);
+void free_strarraygit(git_strarray *array);
 
 int py_object_to_otype(PyObject *py_type);
 
@@ -23,10 +23,16 @@
 # the Free Software Foundation, 51 Franklin Street, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 
+import gzip
+import io
 import os
 import tarfile
+import zipfile
+
+import pytest
 
 from pygit2 import Index, Oid, Tree, Object
+from pygit2.repository import _ParallelGzipWriter
 
 
 TREE_HASH = 'fd937514cb799514d4b81bb24c5fcfeb6472b245'
@@ -62,3 +68,79 @@ def test_write_commit(testrepo):
     check_writing(testrepo, COMMIT_HASH, commit_timestamp)
     check_writing(testrepo, Oid(hex=COMMIT_HASH), commit_timestamp)
     check_writing(testrepo, testrepo[COMMIT_HASH], commit_timestamp)
+
+def test_write_native(testrepo, tmp_path):
+    commit = testrepo[COMMIT_HASH]
+    tree = commit.tree
+    contents = {}
+    index = Index()
+    index.read_tree(tree)
+    for entry in index:
+        contents['prefix/' + entry.path] = testrepo[entry.id].data
+
+    for format in ['tar', 'tar.gz']:
+        output = io.BytesIO()
+        testrepo.write_archive(commit, output, prefix='prefix/', format=format)
+        output.seek(0)
+        with tarfile.open(fileobj=output) as archive:
+            members = archive.getmembers()
+            assert {member.name: archive.extractfile(member).read()
+                    for member in members} == contents
+            assert members[0].mtime == commit.committer.time
+
+    output = io.BytesIO()
+    testrepo.write_archive(TREE_HASH, output, prefix='prefix/', format='zip')
+    with zipfile.ZipFile(output) as archive:
+        assert archive.testzip() is None
+        assert {name: archive.read(name)
+                for name in archive.namelist()} == contents
+
+    path = tmp_path / 'foo.tar'
+    fd = os.open(str(path), os.O_WRONLY | os.O_CREAT)
+    try:
+        testrepo.write_archive(commit, fd, prefix='prefix/')
+    finally:
+        os.close(fd)
+    with tarfile.open(str(path)) as archive:
+        assert sorted(archive.getnames()) == sorted(contents)
+
+    with pytest.raises(ValueError):
+        testrepo.write_archive(commit, io.BytesIO(), format='rar')
+
+def test_write_native_parallel(testrepo, monkeypatch):
+    commit = testrepo[COMMIT_HASH]
+    output = io.BytesIO()
+    testrepo.write_archive(commit, output)
+    tar = output.getvalue()
+
+    # Small blocks, so the tree spans several of them
+    monkeypatch.setattr(_ParallelGzipWriter, 'BLOCK_SIZE', 1024)
+    for threads in [2, None]:
+        output = io.BytesIO()
+        testrepo.write_archive(commit, output, format='tar.gz',
+                               threads=threads)
+        assert gzip.decompress(output.getvalue()) == tar
+
+def test_write_native_short_writes(testrepo):
+    class ShortWriter:
+        """Like a raw file, writes at most 100 bytes at a time."""
+        def __init__(self):
+            self.data = bytearray()
+
+        def write(self, data):
+            data = bytes(data[:100])
+            self.data += data
+            return len(data)
+
+    commit = testrepo[COMMIT_HASH]
+    output = io.BytesIO()
+    testrepo.write_archive(commit, output)
+    tar = output.getvalue()
+
+    output = ShortWriter()
+    testrepo.write_archive(commit, output)
+    assert bytes(output.data) == tar
+
+    output = ShortWriter()
+    testrepo.write_archive(commit, output, format='tar.gz', threads=2)
+    assert gzip.decompress(bytes(output.data)) == tar
@@ -50,3 +50,19 @@ def test_no_attr_aspath(testrepo):
         print('*.py  text\n', file=f)
 
     assert testrepo.get_attr(Path('file.py'), 'text')
+
+def test_get_attrs_many(testrepo):
+    with open(join(testrepo.workdir, '.gitattributes'), 'w+') as f:
+        print('*.py  text\n', file=f)
+        print('*.jpg -text\n', file=f)
+        print('*.sh  eol=lf\n', file=f)
+
+    paths = ['file', 'file.py', 'file.jpg', 'file.sh'] * 10
+    names = ['text', 'eol', 'foo']
+    rows = testrepo.get_attrs_many(paths, names, threads=2)
+    assert rows == [tuple(testrepo.get_attr(path, name) for name in names)
+                    for path in paths]
+    assert rows[:4] == [(None, None, None), (True, None, None),
+                        (False, None, None), (None, 'lf', None)]
+
+    assert testrepo.get_attrs_many(['file.py'], []) == [()]
@@ -27,7 +27,7 @@
 
 import pytest
 
-from pygit2 import Signature, Oid
+from pygit2 import Signature, Oid, BlameCache, GIT_OBJ_BLOB
 
 
 PATH = 'hello.txt'
@@ -119,3 +119,114 @@ def test_blame_newest(testrepo):
             assert HUNKS[i][1] == hunk.orig_start_line_number
             assert HUNKS[i][2] == hunk.orig_committer
             assert HUNKS[i][3] == hunk.boundary
+
+def test_blame_iter(testrepo):
+    hunks = list(testrepo.blame_iter(PATH, first_line=2, step=1))
+    assert [2, 3, 1] == [hunk.final_start_line_number for hunk in hunks]
+    for hunk in hunks:
+        i = hunk.final_start_line_number - 1
+        assert hunk.lines_in_hunk == 1
+        assert HUNKS[i][0] == hunk.final_commit_id
+        assert HUNKS[i][2] == hunk.final_committer
+
+    hunks = list(testrepo.blame_iter(PATH, step=2))
+    assert [1, 2, 3] == [hunk.final_start_line_number for hunk in hunks]
+
+    commit = testrepo.revparse_single('master^2^')
+    hunks = list(testrepo.blame_iter(PATH, newest_commit=commit.id))
+    assert [HUNKS[0][0], HUNKS[1][0]] == [hunk.final_commit_id for hunk in hunks]
+
+def test_blame_hunks_table(testrepo):
+    table = testrepo.blame(PATH).hunks_table()
+
+    assert [1, 1, 1] == list(table.lines)
+    assert [1, 2, 3] == list(table.starts)
+    assert [1, 2, 3] == list(table.orig_starts)
+    assert b''.join(hunk[0].raw for hunk in HUNKS) == table.ids
+    assert table.ids == table.orig_ids
+    assert [1, 0, 0] == list(table.boundaries)
+    assert [PATH] * 3 == table.orig_paths
+
+def _hunks(blame):
+    return [(hunk.final_commit_id, hunk.final_start_line_number,
+             hunk.lines_in_hunk, hunk.orig_start_line_number, hunk.boundary)
+            for hunk in blame]
+
+def test_blame_update(testrepo):
+    revs = ['master^2^^', 'master^2^', 'master^2']
+    commits = [testrepo.revparse_single(rev).id for rev in revs]
+
+    blame = testrepo.blame(PATH, newest_commit=commits[0])
+    for commit in commits[1:]:
+        blame = blame.update(commit)
+        assert _hunks(testrepo.blame(PATH, newest_commit=commit)) == _hunks(blame)
+        assert blame.update(commit) is blame
+    assert HUNKS[2][0] == blame.for_line(3).final_commit_id
+    assert HUNKS[2][2] == blame.for_line(3).final_committer
+
+    # Not a descendant, blamed from scratch
+    blame = blame.update(commits[0])
+    assert _hunks(testrepo.blame(PATH, newest_commit=commits[0])) == _hunks(blame)
+
+def test_blame_for_buffer(testrepo):
+    zero = Oid(raw=b'\0' * 20)
+    data = testrepo[testrepo.head.peel().tree[PATH].id].data
+    first, rest = data.split(b'\n', 1)
+    contents = first + b'\nnew line\n' + rest
+
+    blame = testrepo.blame(PATH)
+    expected = [HUNKS[0][0], zero, HUNKS[1][0], HUNKS[2][0]]
+    edited = blame.for_buffer(contents)
+    assert expected == [hunk.final_commit_id for hunk in edited]
+    assert [1, 2, 3, 4] == [hunk.final_start_line_number for hunk in edited]
+    assert edited[1].final_committer is None
+
+    # Also from a blame made by update()
+    commit = testrepo.revparse_single('master^2^^').id
+    blame = testrepo.blame(PATH, newest_commit=commit).update(
+        testrepo.head.target)
+    edited = blame.for_buffer(contents)
+    assert expected == [hunk.final_commit_id for hunk in edited]
+    assert [1, 2, 3, 4] == list(edited.hunks_table().starts)
+
+def test_blame_for_buffer_chained(testrepo):
+    zero = Oid(raw=b'\0' * 20)
+    data = testrepo[testrepo.head.peel().tree[PATH].id].data
+    first, rest = data.split(b'\n', 1)
+    contents = first + b'\nnew line\n' + rest
+    expected = [zero, HUNKS[0][0], zero, HUNKS[1][0], HUNKS[2][0]]
+
+    commit = testrepo.revparse_single('master^2^^').id
+    blames = [testrepo.blame(PATH),
+              testrepo.blame(PATH, newest_commit=commit).update(
+                  testrepo.head.target)]
+    for blame in blames:
+        # Diffed against the first buffer, not against the blob
+        edited = blame.for_buffer(contents).for_buffer(b'top\n' + contents)
+        assert expected == [hunk.final_commit_id for hunk in edited]
+        assert [1, 2, 3, 4, 5] == [hunk.final_start_line_number
+                                   for hunk in edited]
+
+def test_blame_cache(testrepo):
+    commits = [testrepo.revparse_single(rev).id
+               for rev in ['master^2^^', 'master^2^', 'master^2']]
+    cache = BlameCache(testrepo, size=2)
+
+    for commit in commits:
+        blame = cache.blame(PATH, commit)
+        assert _hunks(testrepo.blame(PATH, newest_commit=commit)) == _hunks(blame)
+        assert cache.blame(PATH, commit.hex) is blame
+
+def test_blame_many(testrepo):
+    tree = testrepo.head.peel().tree
+    paths = [entry.name for entry in tree if entry.type == GIT_OBJ_BLOB]
+    assert PATH in paths
+
+    tables = testrepo.blame_many(paths, threads=2)
+    assert sorted(paths) == sorted(tables)
+    for path in paths:
+        assert testrepo.blame(path).hunks_table() == tables[path]
+
+    commit = testrepo.revparse_single('master^2^')
+    table = testrepo.blame_many([PATH], newest_commit=commit.hex)[PATH]
+    assert b''.join(hunk[0].raw for hunk in HUNKS[:2]) == table.ids
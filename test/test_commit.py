@@ -25,11 +25,13 @@
 
 """Tests for Commit objects."""
 
+import os
 import sys
 
 import pytest
 
-from pygit2 import GIT_OBJ_COMMIT, Signature, Oid
+import pygit2
+from pygit2 import GIT_OBJ_COMMIT, Signature, Oid, GitError
 from . import utils
 
 
@@ -121,6 +123,184 @@ def test_new_commit_encoding(barerepo):
     assert COMMIT_SHA == commit.parents[0].hex
     assert Oid(hex=COMMIT_SHA) == commit.parent_ids[0]
 
+def test_new_commit_from_ids(barerepo):
+    repo = barerepo
+    message = 'New commit.\n\nMessage with non-ascii chars: ééé.\n'
+    committer = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+    author = Signature(
+        'J. David Ibáñez', 'jdavid@example.com', 12345, 0,
+        encoding='utf-8')
+    tree = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+
+    # Same commit as test_new_commit, without loading the tree and parents
+    sha = repo.create_commit_from_ids(None, author, committer, message,
+                                      Oid(hex=tree), (Oid(hex=COMMIT_SHA),))
+    assert '98286caaab3f1fde5bf52c8369b2b0423bad743b' == sha.hex
+
+    sha = repo.create_commit_from_ids(None, author, committer, message,
+                                      tree[:5], [COMMIT_SHA[:5]])
+    assert '98286caaab3f1fde5bf52c8369b2b0423bad743b' == sha.hex
+
+    # Missing objects: rejected when strict, accepted with validate=False
+    missing = '1' * 40
+    pygit2.option(pygit2.GIT_OPT_ENABLE_STRICT_OBJECT_CREATION, True)
+    try:
+        with pytest.raises(GitError):
+            repo.create_commit_from_ids(None, author, committer, message,
+                                        missing, [])
+        sha = repo.create_commit_from_ids(None, author, committer, message,
+                                          missing, [missing], validate=False)
+    finally:
+        pygit2.option(pygit2.GIT_OPT_ENABLE_STRICT_OBJECT_CREATION, True)
+    commit = repo[sha]
+    assert Oid(hex=missing) == commit.tree_id
+    assert [Oid(hex=missing)] == commit.parent_ids
+
+    # Without validation the same commit is written
+    sha = repo.create_commit_from_ids('refs/heads/unchecked', author,
+                                      committer, message, tree, [COMMIT_SHA],
+                                      validate=False)
+    assert '98286caaab3f1fde5bf52c8369b2b0423bad743b' == sha.hex
+    assert sha == repo.references['refs/heads/unchecked'].target
+    with pytest.raises(GitError):
+        repo.create_commit_from_ids('refs/heads/unchecked', author, committer,
+                                    message, tree, [COMMIT_SHA],
+                                    validate=False)
+
+def test_create_commit_buffer(barerepo):
+    repo = barerepo
+    committer = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+    author = Signature('Jane Doe', 'jane@example.com', 12345, -120)
+    tree = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+
+    count = len(list(repo.odb))
+    buf = repo.create_commit_buffer(author, committer, 'New commit.\n',
+                                    tree[:5], [COMMIT_SHA[:5]])
+    assert buf == (
+        b'tree 967fce8df97cc71722d3c2a5930ef3e6f1d27b12\n'
+        b'parent ' + COMMIT_SHA.encode() + b'\n'
+        b'author Jane Doe <jane@example.com> 12345 -0200\n'
+        b'committer John Doe <jdoe@example.com> 12346 +0000\n'
+        b'\n'
+        b'New commit.\n')
+    assert count == len(list(repo.odb))
+
+    sha = repo.odb.write(GIT_OBJ_COMMIT, buf)
+    assert repo[sha].message == 'New commit.\n'
+
+def test_create_commits(testrepo):
+    repo = testrepo
+    sig = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+    head = repo.head.target
+    tree = repo[head].tree_id
+    objects = os.path.join(repo.path, 'objects')
+    packs = set(os.listdir(os.path.join(objects, 'pack')))
+
+    oids = repo.create_commits([
+        (sig, sig, 'one\n', tree, [head]),
+        (sig, sig, 'two\n', tree.hex, [0]),
+        (sig, sig, 'merge\n', tree, [0, 1]),
+    ], update_ref='HEAD')
+
+    assert 3 == len(oids)
+    assert 'refs/heads/master' == repo.head.name
+    assert oids[2] == repo.head.target
+    assert [head] == repo[oids[0]].parent_ids
+    assert oids[:2] == repo[oids[2]].parent_ids
+    assert repo.odb.read(oids[0])[1] == repo.create_commit_buffer(
+        sig, sig, 'one\n', tree, [head])
+
+    # One new pack and no loose objects
+    new = set(os.listdir(os.path.join(objects, 'pack'))) - packs
+    assert 2 == len(new)
+    for oid in oids:
+        assert not os.path.exists(
+            os.path.join(objects, oid.hex[:2], oid.hex[2:]))
+
+    # Nothing is written on error
+    with pytest.raises(IndexError):
+        repo.create_commits([(sig, sig, 'three\n', tree, [1])])
+    assert new == set(os.listdir(os.path.join(objects, 'pack'))) - packs
+    assert oids[2] == repo.head.target
+
+    # The in-memory backend is added once and then reused
+    backends = len(list(repo.odb.backends))
+    repo.create_commits([(sig, sig, 'three\n', tree, [oids[2]])])
+    assert backends == len(list(repo.odb.backends))
+
+def test_create_commits_chunks(testrepo):
+    repo = testrepo
+    sig = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+    head = repo.head.target
+    tree = repo[head].tree_id
+    pack_dir = os.path.join(repo.path, 'objects', 'pack')
+    packs = set(os.listdir(pack_dir))
+
+    records = [(sig, sig, 'one\n', tree, [head])]
+    records += [(sig, sig, '%d\n' % i, tree, [i - 1]) for i in range(1, 5)]
+    oids = repo.create_commits(records, chunk_size=2)
+    assert [oids[3]] == repo[oids[4]].parent_ids
+
+    # A pack and its index per chunk
+    assert 6 == len(set(os.listdir(pack_dir)) - packs)
+
+    with pytest.raises(ValueError):
+        repo.create_commits(records, chunk_size=0)
+
+def test_create_commits_in_pack_writer(testrepo):
+    repo = testrepo
+    sig = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+    head = repo.head.target
+    tree = repo[head].tree_id
+    pack_dir = os.path.join(repo.path, 'objects', 'pack')
+    packs = set(os.listdir(pack_dir))
+
+    with repo.pack_writer() as writer:
+        blob = repo.create_blob(b'packed contents\n')
+        oids = repo.create_commits([(sig, sig, 'one\n', tree, [head])],
+                                   chunk_size=1)
+        # Left to the writer, with its blob
+        assert 2 == len(writer)
+        assert set(os.listdir(pack_dir)) == packs
+
+    assert 2 == len(set(os.listdir(pack_dir)) - packs)
+    assert blob in repo.odb
+    assert oids[0] in repo.odb
+
+def test_commit_template(barerepo):
+    repo = barerepo
+    committer = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+    author = Signature(
+        'J. David Ibáñez', 'jdavid@example.com', 12345, 0,
+        encoding='utf-8')
+    tree = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+    message = 'New commit.\n\nMessage with non-ascii chars: ééé.\n'
+
+    template = repo.CommitTemplate(author=author, committer=committer)
+    # Same commit as test_new_commit
+    sha = template.create(message, tree, [COMMIT_SHA])
+    assert '98286caaab3f1fde5bf52c8369b2b0423bad743b' == sha.hex
+    assert sha == template.create(message.encode('utf-8'), tree, [COMMIT_SHA])
+    assert sha == template.create(message, tree, [COMMIT_SHA], validate=False)
+
+    child = template.create('Child\n', tree, [sha], time=20000, offset=60)
+    commit = repo[child]
+    assert [sha] == commit.parent_ids
+    assert 20000 == commit.author.time == commit.commit_time
+    assert 60 == commit.author.offset == commit.commit_time_offset
+    assert author.name == commit.author.name
+    assert committer.name == commit.committer.name
+
+    # The time is kept for the next commits
+    assert 20000 == repo[template.create('Next\n', tree, [child])].commit_time
+
+    encoding = 'iso-8859-1'
+    template = repo.CommitTemplate(committer, encoding=encoding)
+    commit = repo[template.create(message, tree, [])]
+    assert encoding == commit.message_encoding
+    assert message.encode(encoding) == commit.raw_message
+    assert committer == commit.author == commit.committer
+
 def test_modify_commit(barerepo):
     message = 'New commit.\n\nMessage.\n'
     committer = ('John Doe', 'jdoe@example.com', 12346)
@@ -95,3 +95,22 @@ def test_describe_dirty(dirtyrepo):
 def test_describe_dirty_with_suffix(dirtyrepo):
     add_tag(dirtyrepo, 'thetag', 'a763aa560953e7cfb87ccbc2f536d665aa4dff22')
     assert 'thetag-dirty' == dirtyrepo.describe(dirty_suffix='-dirty')
+
+def test_describe_many(testrepo):
+    add_tag(testrepo, 'thetag', 'acecd5ea2924a4b900e7e149496e1f4b57976e51')
+    commits = ['HEAD', 'HEAD^', testrepo.head,
+               testrepo['6aaa262e655dd54252e5813c8e5acd7780ed097d'],
+               pygit2.Oid(hex='acecd5ea2924a4b900e7e149496e1f4b57976e51'),
+               'HEAD']
+    expected = [testrepo.describe(committish=commit, abbreviated_size=10)
+                for commit in commits]
+    assert expected[0] == 'thetag-4-g2be5719152'
+    assert testrepo.describe_many(commits, threads=2,
+                                  abbreviated_size=10) == expected
+
+def test_describe_many_not_found(testrepo):
+    add_tag(testrepo, 'public/tag2', '4ec4389a8068641da2d6578db0419484972284c8')
+    assert testrepo.describe_many(['HEAD', 'HEAD^'], pattern='public/*') == [
+        'public/tag2-2-g2be5719', None]
+    with pytest.raises(TypeError):
+        testrepo.describe_many(['HEAD'], dirty_suffix='-dirty')
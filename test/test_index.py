@@ -25,6 +25,7 @@
 
 """Tests for Index files."""
 
+import hashlib
 import os
 from pathlib import Path
 
@@ -116,6 +117,57 @@ def test_add_all_aspath(testrepo):
     assert 'bye.txt' in index
     assert 'hello.txt' in index
 
+def test_add_all_threads(testrepo):
+    clear(testrepo)
+
+    index = testrepo.index
+    index.add_all(['*.txt'], threads=2)
+    assert 'bye.txt' in index
+    assert 'hello.txt' in index
+    assert '.gitignore' not in index
+
+    assert index['bye.txt'].hex == '0907563af06c7464d62a70cdd135a6ba7d2b41d8'
+    assert index['hello.txt'].hex == 'a520c24d85fbfc815d385957eed41406ca5a860b'
+
+def test_add_all_threads_modified(testrepo):
+    workdir = Path(testrepo.workdir)
+    (workdir / 'hello.txt').write_bytes(b'hello world\n')
+    (workdir / '.gitignore').unlink()
+
+    index = testrepo.index
+    index.add_all(threads=2)
+    assert '.gitignore' not in index
+    assert 'bye.txt' in index
+    assert index['hello.txt'].id == pygit2.hash(b'hello world\n')
+    assert index['hello.txt'].id in testrepo
+    assert len(index.diff_to_workdir()) == 0
+
+def test_refresh(testrepo):
+    hello = os.path.join(testrepo.workdir, 'hello.txt')
+    os.utime(hello, (0, 0))
+
+    index = testrepo.index
+    index.refresh(threads=2)
+    assert index['hello.txt'].hex == 'a520c24d85fbfc815d385957eed41406ca5a860b'
+    assert testrepo.status(threads=2) == testrepo.status()
+    assert len(index.diff_to_workdir(threads=2)) == 0
+
+def test_threads_file_replaced_by_directory(testrepo):
+    workdir = Path(testrepo.workdir)
+    (workdir / 'bye.txt').unlink()
+    (workdir / 'bye.txt').mkdir()
+    (workdir / 'bye.txt' / 'inner.txt').write_bytes(b'inner\n')
+
+    assert testrepo.status(threads=2) == testrepo.status()
+    assert testrepo.is_dirty(threads=2)
+    testrepo.index.refresh(threads=2)
+    assert 'bye.txt' in testrepo.index
+
+    index = testrepo.index
+    index.add_all(threads=2)
+    assert 'bye.txt' not in index
+    assert index['bye.txt/inner.txt'].id == pygit2.hash(b'inner\n')
+
 def clear(repo):
     index = repo.index
     assert len(index) == 2
@@ -132,6 +184,58 @@ def test_write(testrepo):
     index.read()
     assert 'bye.txt' in index
 
+def test_extensions(testrepo):
+    index = testrepo.index
+    index.read_tree(testrepo.head.peel().tree)
+    index.write()
+    assert 'TREE' in index.extensions
+    assert index.fsmonitor_token is None
+    assert Index().extensions == {}
+
+    # Add a version 2 FSMN extension, as git would
+    path = os.path.join(testrepo.path, 'index')
+    with open(path, 'rb') as f:
+        data = f.read()[:-20]
+    fsmn = b'\0\0\0\x02token\0\0\0\0\0'
+    data += b'FSMN' + len(fsmn).to_bytes(4, 'big') + fsmn
+    with open(path, 'wb') as f:
+        f.write(data + hashlib.sha1(data).digest())
+
+    assert index.extensions['FSMN'] == fsmn
+    assert index.fsmonitor_token == 'token'
+
+
+def test_tree_cache(testrepo):
+    index = testrepo.index
+    hello_entry = index['hello.txt']
+    index.add_entries(['a/b/c', 'x/y'], [hello_entry.id] * 2, hello_entry.mode)
+    tree_id = index.write_tree()
+    index.write()
+    cache = index.tree_cache
+    assert cache[''] == tree_id
+    assert sorted(cache) == ['', 'a', 'a/b', 'x']
+    assert None not in cache.values()
+
+    # Only the directories of the path are invalidated
+    index.add(pygit2.IndexEntry('x/z', hello_entry.id, hello_entry.mode))
+    index.write()
+    cache = index.tree_cache
+    assert cache[''] is None and cache['x'] is None
+    assert cache['a'] is not None and cache['a/b'] is not None
+
+def test_version(testrepo):
+    index = testrepo.index
+    assert index.version in (2, 3)
+    index.version = 4
+    index.write()
+
+    path = os.path.join(testrepo.path, 'index')
+    with open(path, 'rb') as f:
+        assert f.read(8) == b'DIRC\0\0\0\x04'
+    index = Index(path)
+    assert index.version == 4
+    assert [entry.path for entry in index] == ['.gitignore', 'hello.txt']
+
 
 def test_read_tree(testrepo):
     tree_oid = '68aba62e560c0ebc3396e8ae9335232cd93a3f60'
@@ -242,6 +346,45 @@ def test_create_entry_aspath(testrepo):
     index.add(entry)
     index.write_tree()
 
+def test_add_entries(testrepo):
+    hello_entry = testrepo.index['hello.txt']
+    paths = ['b/%d.txt' % i for i in range(50)] + ['a.txt', 'c']
+
+    index = Index()
+    index.add_entries(reversed(paths), hello_entry.id.raw * len(paths),
+                      hello_entry.mode)
+    assert [entry.path for entry in index] == sorted(paths)
+
+    expected = Index()
+    for path in paths:
+        expected.add(pygit2.IndexEntry(path, hello_entry.id, hello_entry.mode))
+    assert index.write_tree(testrepo) == expected.write_tree(testrepo)
+
+    # Merged with the existing entries, the new ones win
+    index = testrepo.index
+    index.add_entries([
+        pygit2.IndexEntry('z.txt', hello_entry.id, hello_entry.mode),
+        pygit2.IndexEntry('.gitignore', hello_entry.id, hello_entry.mode),
+    ])
+    assert [entry.path for entry in index] == ['.gitignore', 'hello.txt', 'z.txt']
+    assert index['.gitignore'].id == hello_entry.id
+
+    with pytest.raises(ValueError):
+        index.add_entries(['a'], [], hello_entry.mode)
+
+def test_entries_table(testrepo):
+    index = testrepo.index
+    table = index.entries_table()
+    assert table.paths == [entry.path for entry in index]
+    assert list(table.modes) == [entry.mode for entry in index]
+    assert table.ids == b''.join(entry.id.raw for entry in index)
+    assert list(table.stages) == [0, 0]
+    assert len(table.sizes) == len(table.mtimes) == 2
+
+    copy = Index()
+    copy.add_entries(table.paths, table.ids, table.modes)
+    assert copy.write_tree(testrepo) == index.write_tree()
+
 
 def test_create_empty():
     Index()
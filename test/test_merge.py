@@ -183,3 +183,83 @@ def test_merge_trees_favor(mergerepo):
 
     with pytest.raises(ValueError):
         mergerepo.merge_trees(ancestor_id, mergerepo.head.target, branch_head_hex, favor='foo')
+
+def test_merge_check(mergerepo):
+    head = mergerepo.head.target
+    clean_hex = '03490f16b15a09913edb3a067a3dc67fbb8d41f1'
+    ancestor_id = mergerepo.merge_base(head, clean_hex)
+    clean, conflicts, tree_id = mergerepo.merge_check(ancestor_id, head, clean_hex)
+    assert clean and conflicts == []
+    merge_index = mergerepo.merge_trees(ancestor_id, head, clean_hex)
+    assert tree_id == merge_index.write_tree(mergerepo)
+
+    conflict_hex = '1b2bae55ac95a4be3f8983b86cd579226d0eb247'
+    ancestor_id = mergerepo.merge_base(head, conflict_hex)
+    assert mergerepo.merge_check(ancestor_id, head, conflict_hex) == (
+        False, ['.gitignore'], None)
+    clean, conflicts, tree_id = mergerepo.merge_check(
+        mergerepo[ancestor_id], head, conflict_hex, favor='ours')
+    assert clean and tree_id is not None
+
+    with pytest.raises(ValueError):
+        mergerepo.merge_check(ancestor_id, head, conflict_hex, favor='foo')
+
+def test_merge_check_many(mergerepo):
+    head = mergerepo.head.target
+    triples = []
+    for hex in ['03490f16b15a09913edb3a067a3dc67fbb8d41f1',
+                '1b2bae55ac95a4be3f8983b86cd579226d0eb247'] * 3:
+        triples.append((mergerepo.merge_base(head, hex), head, hex))
+
+    results = mergerepo.merge_check_many(triples, threads=2)
+    assert results == [mergerepo.merge_check(*triple) for triple in triples]
+    assert [clean for clean, conflicts, tree_id in results] == [True, False] * 3
+
+def test_rebase_commits(mergerepo):
+    head = mergerepo.head.target
+    branch_head_hex = '03490f16b15a09913edb3a067a3dc67fbb8d41f1'
+    status = mergerepo.status()
+
+    result = mergerepo.rebase_commits(head, branch_head_hex,
+                                      update_ref='refs/heads/replayed')
+    assert result.stopped_at is None and result.conflicts == []
+    assert len(result.commits) > 0
+    assert mergerepo.references['refs/heads/replayed'].target == result.commits[-1]
+
+    new_commit = mergerepo[result.commits[-1]]
+    assert new_commit.tree.id == result.tree
+    assert new_commit.message == mergerepo[branch_head_hex].message
+    assert new_commit.author == mergerepo[branch_head_hex].author
+    assert mergerepo[result.commits[0]].parent_ids == [head]
+    assert mergerepo.head.target == head
+    assert mergerepo.status() == status
+
+def test_rebase_commits_in_pack_writer(mergerepo):
+    head = mergerepo.head.target
+    branch_head_hex = '03490f16b15a09913edb3a067a3dc67fbb8d41f1'
+
+    with mergerepo.pack_writer() as writer:
+        blob = mergerepo.create_blob(b'packed contents\n')
+        result = mergerepo.rebase_commits(head, branch_head_hex)
+        # Left to the writer, with its blob
+        assert len(writer) >= len(result.commits) + 1
+        assert blob in mergerepo.odb
+
+    assert blob in mergerepo.odb
+    for oid in result.commits:
+        assert oid in mergerepo.odb
+
+def test_rebase_commits_conflict(mergerepo):
+    head = mergerepo.head.target
+    branch_head_hex = '1b2bae55ac95a4be3f8983b86cd579226d0eb247'
+    status = mergerepo.status()
+
+    result = mergerepo.rebase_commits(head, branch_head_hex,
+                                      update_ref='refs/heads/replayed')
+    assert result.stopped_at is not None
+    assert result.conflicts == ['.gitignore']
+    assert 'refs/heads/replayed' not in mergerepo.references
+    assert mergerepo.status() == status
+
+    result = mergerepo.replay_commits([branch_head_hex], head, favor='ours')
+    assert result.stopped_at is None and len(result.commits) == 1
@@ -33,8 +33,8 @@ import os
 import pytest
 
 # pygit2
-from pygit2 import Odb, Oid
-from pygit2 import GIT_OBJ_ANY, GIT_OBJ_BLOB
+from pygit2 import Odb, Oid, Signature
+from pygit2 import GIT_OBJ_ANY, GIT_OBJ_BLOB, GIT_FILEMODE_BLOB
 from . import utils
 
 
@@ -91,3 +91,41 @@ def test_write(odb):
 
     oid = odb.write(GIT_OBJ_BLOB, data)
     assert type(oid) == Oid
+
+def test_pack_writer(barerepo):
+    pack_dir = os.path.join(barerepo.path, 'objects', 'pack')
+    packs = set(os.listdir(pack_dir))
+    sig = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+
+    with barerepo.pack_writer() as writer:
+        blob = barerepo.create_blob(b'packed contents\n')
+        assert 1 == len(writer)
+        # Readable before the pack is written
+        assert b'packed contents\n' == barerepo[blob].data
+        assert blob == barerepo[blob.hex[:10]].id
+        builder = barerepo.TreeBuilder()
+        builder.insert('packed', blob, GIT_FILEMODE_BLOB)
+        tree = builder.write()
+        commit = barerepo.create_commit(None, sig, sig, 'Packed\n', tree, [])
+        assert 3 == len(writer)
+
+    assert 0 == len(writer)
+    assert 2 == len(set(os.listdir(pack_dir)) - packs)
+    for oid in (blob, tree, commit):
+        loose = os.path.join(barerepo.path, 'objects', oid.hex[:2], oid.hex[2:])
+        assert not os.path.exists(loose)
+        assert oid in barerepo.odb
+    assert barerepo[commit].tree['packed'].id == blob
+
+    # Once closed writes are loose again
+    other = barerepo.create_blob(b'loose contents\n')
+    assert os.path.exists(
+        os.path.join(barerepo.path, 'objects', other.hex[:2], other.hex[2:]))
+    with pytest.raises(ValueError):
+        writer.write()
+
+    # The same backend is used again
+    backends = len(list(barerepo.odb.backends))
+    with barerepo.pack_writer():
+        barerepo.create_blob(b'more packed contents\n')
+    assert backends == len(list(barerepo.odb.backends))
@@ -142,6 +142,99 @@ def test_checkout_paths(testrepo):
     status = testrepo.status()
     assert status['new'] == pygit2.GIT_STATUS_INDEX_NEW
 
+def test_checkout_callbacks(testrepo):
+    class MyCallbacks(pygit2.CheckoutCallbacks):
+        def __init__(self):
+            super().__init__()
+            self.progress = []
+            self.perfdata = None
+
+        def checkout_progress(self, path, completed_steps, total_steps):
+            self.progress.append((path, completed_steps, total_steps))
+
+        def checkout_perfdata(self, mkdir_calls, stat_calls, chmod_calls):
+            self.perfdata = (mkdir_calls, stat_calls, chmod_calls)
+
+    ref_i18n = testrepo.lookup_reference('refs/heads/i18n')
+    callbacks = MyCallbacks()
+    testrepo.checkout(ref_i18n, callbacks=callbacks)
+    assert callbacks.progress[0] == (None, 0, callbacks.progress[-1][2])
+    assert 'new' in [path for path, completed, total in callbacks.progress]
+    assert callbacks.perfdata is not None
+
+    class FailingCallbacks(pygit2.CheckoutCallbacks):
+        def checkout_progress(self, path, completed_steps, total_steps):
+            raise ValueError(path)
+
+    with pytest.raises(ValueError):
+        testrepo.checkout('HEAD', strategy=pygit2.GIT_CHECKOUT_FORCE,
+                          callbacks=FailingCallbacks())
+
+def test_checkout_sparse(testrepo):
+    blob_id = testrepo.create_blob(b'content')
+    paths = ['a.txt', 'x/g', 'x/y/f', 'x/y/z/e', 'z/h']
+    index = pygit2.Index()
+    index.add_entries(paths, [blob_id] * len(paths), pygit2.GIT_FILEMODE_BLOB)
+    tree = testrepo[index.write_tree(testrepo)]
+
+    extra_dir = os.path.join(testrepo.workdir, 'extra-dir')
+    os.mkdir(extra_dir)
+    testrepo.checkout_tree(tree, directory=extra_dir, sparse=['x/y'])
+    checked_out = sorted(
+        os.path.relpath(os.path.join(root, name), extra_dir).replace(os.sep, '/')
+        for root, dirs, files in os.walk(extra_dir) for name in files)
+    assert checked_out == ['a.txt', 'x/g', 'x/y/f', 'x/y/z/e']
+
+    os.makedirs(os.path.join(testrepo.path, 'info'), exist_ok=True)
+    with open(os.path.join(testrepo.path, 'info', 'sparse-checkout'), 'w') as f:
+        f.write('/*\n!/*/\n/x/\n!/x/*/\n/x/y/\n')
+    assert testrepo.sparse_checkout_cone() == ['x/y']
+
+    with pytest.raises(ValueError):
+        testrepo.checkout_tree(tree, sparse=True, paths=['a.txt'])
+
+    # An empty or missing cone means a full checkout
+    testrepo.checkout_head(sparse=None)
+    testrepo.checkout_head(sparse=[])
+    testrepo.checkout_head(sparse=False, threads=2)
+    assert not testrepo.is_dirty(untracked_files='no')
+
+def test_checkout_threads(testrepo, tmp_path):
+    strategy = pygit2.GIT_CHECKOUT_SAFE | pygit2.GIT_CHECKOUT_DONT_UPDATE_INDEX
+    serial_dir = tmp_path / 'serial'
+    parallel_dir = tmp_path / 'parallel'
+    testrepo.checkout_head(directory=str(serial_dir), strategy=strategy)
+    testrepo.checkout_head(directory=str(parallel_dir), strategy=strategy,
+                           threads=2)
+
+    names = sorted(os.listdir(serial_dir))
+    assert sorted(os.listdir(parallel_dir)) == names
+    for name in names:
+        assert (parallel_dir / name).read_bytes() == (serial_dir / name).read_bytes()
+
+    # Binary files are written as they are, and another directory does not
+    # touch the repository index
+    data = bytes(range(256)) * 4
+    blob_id = testrepo.create_blob(data)
+    index = pygit2.Index()
+    index.add_entries(['bin/data', 'text'], [blob_id, blob_id],
+                      pygit2.GIT_FILEMODE_BLOB)
+    tree = testrepo[index.write_tree(testrepo)]
+    entries = [(entry.path, entry.id) for entry in testrepo.index]
+    binary_dir = tmp_path / 'binary'
+    testrepo.checkout_tree(tree, directory=str(binary_dir), threads=2)
+    assert (binary_dir / 'bin' / 'data').read_bytes() == data
+    assert (binary_dir / 'text').read_bytes() == data
+    testrepo.index.read()
+    assert [(entry.path, entry.id) for entry in testrepo.index] == entries
+
+    # Into the working directory, the index is updated too
+    for name in names:
+        os.remove(os.path.join(testrepo.workdir, name))
+    testrepo.checkout_head(threads=2)
+    assert not testrepo.is_dirty(untracked_files='no')
+    assert None not in testrepo.index.tree_cache.values()
+
 def test_merge_base(testrepo):
     commit = testrepo.merge_base(
         '5ebeeebb320790caf276b9fc8b24546d63316533',
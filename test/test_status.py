@@ -23,6 +23,10 @@
 # the Free Software Foundation, 51 Franklin Street, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 
+import pytest
+
+import pygit2
+
 
 def test_status(dirtyrepo):
     """
@@ -32,3 +36,59 @@ def test_status(dirtyrepo):
     for filepath, status in git_status.items():
         assert filepath in git_status
         assert status == git_status[filepath]
+
+
+def test_status_paths(dirtyrepo):
+    git_status = dirtyrepo.status(paths=['subdir/*'])
+    assert set(git_status) == {
+        'subdir/deleted_file',
+        'subdir/modified_file',
+        'subdir/new_file',
+    }
+
+    git_status = dirtyrepo.status(paths=('subdir/*',))
+    assert set(git_status) == {
+        'subdir/deleted_file',
+        'subdir/modified_file',
+        'subdir/new_file',
+    }
+
+    with pytest.raises(TypeError):
+        dirtyrepo.status(paths='subdir/*')
+    with pytest.raises(TypeError):
+        dirtyrepo.is_dirty(paths=b'subdir/*')
+
+
+def test_status_untracked_files(dirtyrepo):
+    git_status = dirtyrepo.status(untracked_files='no')
+    assert 'new_file' not in git_status
+    assert 'subdir/new_file' not in git_status
+    assert 'modified_file' in git_status
+
+    with pytest.raises(ValueError):
+        dirtyrepo.status(untracked_files='maybe')
+
+    assert dirtyrepo.status(untracked_files=None) == dirtyrepo.status()
+    git_status = dict(dirtyrepo.status_iter(untracked_files=None))
+    assert git_status == dirtyrepo.status()
+
+
+def test_status_show(dirtyrepo):
+    git_status = dirtyrepo.status(show=pygit2.GIT_STATUS_SHOW_INDEX_ONLY)
+    assert 'modified_file' not in git_status
+    assert git_status['staged_changes'] == pygit2.GIT_STATUS_INDEX_MODIFIED
+
+
+def test_status_iter(dirtyrepo):
+    assert dict(dirtyrepo.status_iter()) == dirtyrepo.status()
+
+    git_status = dict(dirtyrepo.status_iter(untracked_files='no'))
+    assert git_status == dirtyrepo.status(untracked_files='no')
+
+
+def test_is_dirty(dirtyrepo, mergerepo):
+    assert dirtyrepo.is_dirty()
+    assert dirtyrepo.is_dirty(paths=['subdir/*'])
+    assert not dirtyrepo.is_dirty(paths=['no-such-path'])
+    assert dirtyrepo.is_dirty(paths=iter(['subdir/*']))
+    assert not mergerepo.is_dirty()
@@ -23,6 +23,10 @@
 # the Free Software Foundation, 51 Franklin Street, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 
+import pytest
+
+import pygit2
+
 
 TREE_SHA = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
 
@@ -61,3 +65,60 @@ def test_rebuild_treebuilder(barerepo):
 
     assert len(bld) == len(tree)
     assert tree.id == result
+
+
+def test_insert_many(barerepo):
+    tree = barerepo[TREE_SHA]
+    entries = list(tree)
+    names = [entry.name for entry in entries]
+
+    bld = barerepo.TreeBuilder()
+    bld.insert_many(names, [entry.hex for entry in entries],
+                    [entry.filemode for entry in entries])
+    assert bld.write() == tree.id
+
+    packed = b''.join(entry.id.raw for entry in entries)
+    bld = barerepo.TreeBuilder()
+    bld.insert_many(names, packed, [entry.filemode for entry in entries])
+    assert bld.write() == tree.id
+
+    with pytest.raises(ValueError):
+        bld.insert_many(names, packed[:20], pygit2.GIT_FILEMODE_BLOB)
+
+
+def test_insert_many_no_validate(barerepo):
+    tree = barerepo[TREE_SHA]
+    entries = list(tree)
+    names = [entry.name for entry in entries]
+    packed = b''.join(entry.id.raw for entry in entries)
+
+    # Same tree as with the validation
+    bld = barerepo.TreeBuilder()
+    bld.insert_many(names, packed, [entry.filemode for entry in entries],
+                    validate=False)
+    assert len(bld) == len(tree)
+    assert bld.get(names[0]).id == entries[0].id
+    assert bld.write() == tree.id
+
+    # The caller guarantees the objects exist
+    missing = b'\x01' * 20
+    bld = barerepo.TreeBuilder(tree)
+    with pytest.raises(pygit2.GitError):
+        bld.insert_many(['missing'], missing, pygit2.GIT_FILEMODE_BLOB)
+    bld.insert_many(['missing'], missing, pygit2.GIT_FILEMODE_BLOB,
+                    validate=False)
+    assert len(bld) == len(tree) + 1
+    result = barerepo[bld.write()]
+    assert result['missing'].id == pygit2.Oid(raw=missing)
+
+    bld.remove('missing')
+    assert len(bld) == len(tree)
+    assert bld.write() == tree.id
+
+    # Names and modes are still checked
+    for name in ['', 'a/b', '..', '.git']:
+        with pytest.raises(ValueError):
+            bld.insert_many([name], missing, pygit2.GIT_FILEMODE_BLOB,
+                            validate=False)
+    with pytest.raises(ValueError):
+        bld.insert_many(['name'], missing, 0o100600, validate=False)
@@ -0,0 +1,80 @@
+# Copyright 2010-2020 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+
+import pytest
+
+import pygit2
+
+
+TREE_SHA = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+
+
+def test_noop_treeeditor(barerepo):
+    tree = barerepo[TREE_SHA]
+    editor = barerepo.TreeEditor(tree)
+    assert len(editor) == 0
+    assert editor.write() == tree.id
+
+
+def test_tree_from_other_repository(barerepo, testrepo):
+    tree = testrepo.head.peel(pygit2.Tree)
+    with pytest.raises(TypeError):
+        barerepo.TreeEditor(tree)
+
+
+def test_upsert_remove(barerepo):
+    tree = barerepo[TREE_SHA]
+    entry = next(iter(tree))
+    editor = barerepo.TreeEditor(TREE_SHA)
+    editor.upsert('a/b/c.txt', entry.id, pygit2.GIT_FILEMODE_BLOB)
+    editor.remove(entry.name)
+    assert len(editor) == 2
+    result = barerepo[editor.write()]
+    assert len(editor) == 0
+
+    assert entry.name not in result
+    assert result['a/b/c.txt'].id == entry.id
+    assert len(result) == len(tree)
+
+    # The written tree is the base of the next changes
+    editor.remove('a/b/c.txt')
+    editor.upsert(entry.name, entry.id, entry.filemode)
+    assert editor.write() == tree.id
+
+
+def test_from_empty(barerepo):
+    tree = barerepo[TREE_SHA]
+    editor = barerepo.TreeEditor()
+    for entry in tree:
+        editor.upsert(entry.name, entry.id, entry.filemode)
+    assert editor.write() == tree.id
+
+
+def test_remove_missing(barerepo):
+    editor = barerepo.TreeEditor(TREE_SHA)
+    editor.remove('no/such/file')
+    with pytest.raises((pygit2.GitError, KeyError)):
+        editor.write()